@@ -1,31 +1,11 @@
 #ifndef CELLULAR_AUTOMATA_H__
 #define CELLULAR_AUTOMATA_H__
 
+#include "MultiArray.h"
+
 #include <vector>
 #include <array>
 
-template<class T, std::size_t Dim>
-struct multi_vector_impl {
-	static_assert( Dim > 1 );
-	using type = std::vector<typename multi_vector_impl<T,Dim-1>::type>;
-};
-template<class T>
-struct multi_vector_impl<T,1> {
-	using type = std::vector<T>;
-};
-
-template<class T, std::size_t Dim>
-struct multi_vector_t : public multi_vector_impl<T,Dim>::type {
-	typedef typename multi_vector_impl<T,Dim>::type type;
-	using type::type;
-	multi_vector_t(const type& v) : type(v) {}
-	multi_vector_t<T,Dim-1>& child(int i)
-	{
-		typename multi_vector_t<T,Dim-1>::type& ret = type::at(i);
-		return *static_cast<multi_vector_t<T,Dim-1>*>(&ret);
-	}
-};
-
 template<class T, std::size_t Dim>
 std::array<int,Dim> getDimensions(multi_vector_t<T,Dim>& vec)
 {
@@ -41,7 +21,7 @@ std::array<int,Dim> getDimensions(multi_vector_t<T,Dim>& vec)
 }
 
 template<class T, std::size_t Dim, std::size_t Dim2>
-auto getElement(multi_vector_t<T,Dim>& vec, std::array<int,Dim2> F)
+decltype(auto) getElement(multi_vector_t<T,Dim>& vec, std::array<int,Dim2> F)
 {
 	static_assert( Dim2 >= Dim );
 	if constexpr (Dim-1 > 0)
@@ -50,7 +30,7 @@ auto getElement(multi_vector_t<T,Dim>& vec, std::array<int,Dim2> F)
 		return vec.at(F.at(Dim2-Dim));
 }
 
-template<int I, typename T, int Dim>
+template<int I, typename T, std::size_t Dim>
 void recursive_resize(T& vec, std::array<int,Dim> sizes)
 {
 	vec.resize(sizes.at(I));
@@ -61,9 +41,21 @@ void recursive_resize(T& vec, std::array<int,Dim> sizes)
 
 
 #include "TemplateConfig.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <limits>
 #include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <functional>
+#include <utility>
 
 template <typename T, typename = std::void_t<>>
 struct is_std_hashable : std::false_type { };
@@ -76,121 +68,1026 @@ constexpr bool is_std_hashable_v = is_std_hashable<T>::value;
 
 
 // should provide:
-//   static constexpr void addNeighborCounts(std::unordered_map<T,int>& neighborCounts, const T& location);
-// if the type T is hashable, and
-//   static constexpr void addNeighborCounts(std::map<T,int>& neighborCounts, const T& location);
-// if not.
+//   template<class Func> static constexpr void forEachNeighbor(const T& location, Func&& func);
+//   template<class Map> static constexpr void addNeighborCounts(Map& neighborCounts, const T& location);
+// where Map is a CALocationTable<T,int> if the helper provides
+//   static std::uint64_t hash(const T& location);
+// and otherwise std::unordered_map<T,int> if the type T is hashable, and std::map<T,int> if not.
 template<class T>
 struct CALocationHelper;
 
+template <typename T, typename = std::void_t<>>
+struct has_ca_location_hash : std::false_type { };
+
+template <typename T>
+struct has_ca_location_hash<T, std::void_t<decltype(CALocationHelper<T>::hash(std::declval<const T&>()))>> : std::true_type { };
+
+//hash table of locations with open addressing and linear probing, in a single array of slots.
+//Erasing shifts the following entries of the probe sequence back, so there are no tombstones, and
+//  clear() keeps the slots: once a table has grown to its working size it does not allocate again.
+//Inserting or erasing moves entries, so references and iterators are only valid until the next change.
+template<class Key, class Value>
+class CALocationTable {
+	std::vector<std::pair<Key,Value>> slots;
+	std::vector<char> used;
+	std::size_t entries = 0;
+	int shift = 64; //64 - log2(slots.size())
+
+	std::size_t home(const Key& key) const
+	{
+		return (CALocationHelper<Key>::hash(key) * 0x9e3779b97f4a7c15ull) >> shift;
+	}
+	std::size_t mask() const {return slots.size()-1;}
+	void grow()
+	{
+		shift = slots.empty() ? 64-4 : shift-1;
+		std::vector<std::pair<Key,Value>> oldSlots(slots.empty() ? 16 : 2*slots.size());
+		std::vector<char> oldUsed(oldSlots.size(), false);
+		oldSlots.swap(slots);
+		oldUsed.swap(used);
+		for(std::size_t i = 0; i < oldSlots.size(); ++i)
+			if( oldUsed[i] )
+				place(std::move(oldSlots[i]));
+	}
+	std::size_t place(std::pair<Key,Value>&& entry)
+	{
+		std::size_t i = home(entry.first);
+		while( used[i] )
+			i = (i+1) & mask();
+		slots[i] = std::move(entry);
+		used[i] = true;
+		return i;
+	}
+	std::size_t findSlot(const Key& key) const
+	{
+		if( entries == 0 )
+			return slots.size();
+		for(std::size_t i = home(key); used[i]; i = (i+1) & mask())
+			if( slots[i].first == key )
+				return i;
+		return slots.size();
+	}
+public:
+	template<class Table, class Entry>
+	class basic_iterator {
+		Table* table;
+		std::size_t i;
+		friend class CALocationTable;
+	public:
+		basic_iterator(Table* table, std::size_t i) : table(table), i(i)
+		{
+			while( this->i < table->slots.size() and !table->used[this->i] )
+				++this->i;
+		}
+		Entry& operator * () const {return table->slots[i];}
+		Entry* operator -> () const {return &table->slots[i];}
+		basic_iterator& operator ++ ()
+		{
+			*this = basic_iterator(table, i+1);
+			return *this;
+		}
+		bool operator == (const basic_iterator& other) const {return i == other.i;}
+		bool operator != (const basic_iterator& other) const {return i != other.i;}
+	};
+	typedef basic_iterator<CALocationTable,std::pair<Key,Value>> iterator;
+	typedef basic_iterator<const CALocationTable,const std::pair<Key,Value>> const_iterator;
+
+	iterator begin() {return iterator(this, 0);}
+	iterator end() {return iterator(this, slots.size());}
+	const_iterator begin() const {return const_iterator(this, 0);}
+	const_iterator end() const {return const_iterator(this, slots.size());}
+	std::size_t size() const {return entries;}
+	bool empty() const {return entries == 0;}
+
+	iterator find(const Key& key) {return iterator(this, findSlot(key));}
+	const_iterator find(const Key& key) const {return const_iterator(this, findSlot(key));}
+	std::size_t count(const Key& key) const {return findSlot(key) != slots.size();}
+
+	std::pair<iterator,bool> emplace(const Key& key, const Value& value)
+	{
+		std::size_t i = findSlot(key);
+		if( i != slots.size() )
+			return {iterator(this, i), false};
+		if( 2*(entries+1) > slots.size() ) //at most half full
+			grow();
+		++entries;
+		return {iterator(this, place(std::pair<Key,Value>(key, value))), true};
+	}
+	Value& operator [] (const Key& key)
+	{
+		return emplace(key, Value{}).first->second;
+	}
+	void erase(iterator it)
+	{
+		std::size_t hole = it.i;
+		used[hole] = false;
+		--entries;
+		//move back entries that could not be at their home slot because of the erased one
+		for(std::size_t i = (hole+1) & mask(); used[i]; i = (i+1) & mask())
+		{
+			const std::size_t h = home(slots[i].first);
+			if( ((i - h) & mask()) >= ((i - hole) & mask()) )
+			{
+				slots[hole] = std::move(slots[i]);
+				used[hole] = true;
+				used[i] = false;
+				hole = i;
+			}
+		}
+	}
+	void clear()
+	{
+		if( entries == 0 )
+			return;
+		std::fill(used.begin(), used.end(), false);
+		entries = 0;
+	}
+};
+
 struct CAConfigDim {};
 struct CAConfigCellState {};
 struct CAConfigLocation {};
 struct CAConfigAliveState {};
+struct CAConfigBackend {};
+struct CAConfigRule {};
+
+// Neighborhoods: the cells whose alive states are counted for a cell. A neighborhood provides
+//   static constexpr int Radius;
+//   template<std::size_t Dim> static constexpr bool contains(const std::array<int,Dim>& offset);
+// for offsets within Radius in every dimension; the cell itself is never counted.
+// contains() must be symmetric (contains(-offset) == contains(offset)): the grids count neighbors by
+//   adding each alive cell to the cells around it, which is only the same as counting the cells around
+//   each cell when the neighborhood is its own mirror image. caNeighborhoodOffsets() static_asserts it.
+template<int R = 1>
+struct CAMoore {
+	static constexpr int Radius = R;
+	template<std::size_t Dim>
+	static constexpr bool contains(const std::array<int,Dim>&) {return true;}
+};
+template<int R = 1>
+struct CAVonNeumann {
+	static constexpr int Radius = R;
+	template<std::size_t Dim>
+	static constexpr bool contains(const std::array<int,Dim>& offset)
+	{
+		int distance = 0;
+		for(int O : offset)
+			distance += O < 0 ? -O : O;
+		return distance <= R;
+	}
+};
+
+//calls func(offset) for every offset of the neighborhood, the last index varying fastest
+template<class Neighborhood, std::size_t Dim, class Func>
+constexpr void caForEachOffset(Func&& func)
+{
+	std::size_t cube = 1;
+	for(std::size_t d = 0; d < Dim; ++d)
+		cube *= 2*Neighborhood::Radius+1;
+	for(std::size_t i = 0; i < cube; ++i)
+	{
+		std::array<int,Dim> offset{};
+		bool isSelf = true;
+		std::size_t digits = i;
+		for(std::size_t d = Dim; d-- > 0; digits /= 2*Neighborhood::Radius+1)
+		{
+			offset[d] = int(digits % (2*Neighborhood::Radius+1)) - Neighborhood::Radius;
+			isSelf = isSelf and offset[d] == 0;
+		}
+		if( !isSelf and Neighborhood::template contains<Dim>(offset) )
+			func(offset);
+	}
+}
+template<class Neighborhood, std::size_t Dim>
+constexpr std::size_t caNeighborhoodSize()
+{
+	std::size_t n = 0;
+	caForEachOffset<Neighborhood,Dim>([&](const std::array<int,Dim>&) {++n;});
+	return n;
+}
+template<class Neighborhood, std::size_t Dim>
+constexpr bool caNeighborhoodSymmetric()
+{
+	bool symmetric = true;
+	caForEachOffset<Neighborhood,Dim>([&](const std::array<int,Dim>& offset) {
+		std::array<int,Dim> mirrored{};
+		for(std::size_t d = 0; d < Dim; ++d)
+			mirrored[d] = -offset[d];
+		symmetric = symmetric and Neighborhood::template contains<Dim>(mirrored);
+	});
+	return symmetric;
+}
+template<class Neighborhood, std::size_t Dim>
+constexpr std::array<std::array<int,Dim>,caNeighborhoodSize<Neighborhood,Dim>()> caNeighborhoodOffsets()
+{
+	static_assert(caNeighborhoodSymmetric<Neighborhood,Dim>(), "neighborhoods must contain -offset for every offset they contain");
+	std::array<std::array<int,Dim>,caNeighborhoodSize<Neighborhood,Dim>()> ret{};
+	std::size_t n = 0;
+	caForEachOffset<Neighborhood,Dim>([&](const std::array<int,Dim>& offset) {ret[n++] = offset;});
+	return ret;
+}
+
+// Rules, given with MyConfig::Config<CAConfigRule, Rule> instead of an updateFunc. A rule provides
+//   typedef ... Neighborhood;
+//   static constexpr int NumStates;
+//   static constexpr int next(int state, int neighborCount);
+// and is tabulated at compile time, so stepping looks the next state up instead of calling a std::function.
+// State 1 is alive, and 0 is the default state. Counts are given as masks, made with caCounts:
+//   Config<CAConfigRule, CALifeRule<caCounts(3), caCounts(2,3)>>                                    Game of Life
+//   Config<CAConfigRule, CAGenerationsRule<caCounts(2), caCounts(), 3>>, Config<CAConfigCellState,int>  Brian's Brain
+template<class... Counts>
+constexpr std::uint64_t caCounts(Counts... counts)
+{
+	return (std::uint64_t(0) | ... | (std::uint64_t(1) << counts));
+}
+
+//two states: born with a count in Birth, stays alive with a count in Survival
+template<std::uint64_t Birth, std::uint64_t Survival, class NeighborhoodType = CAMoore<1>>
+struct CALifeRule {
+	static_assert( !(Birth & 1), "birth with 0 neighbors would fill the infinite plane" );
+	typedef NeighborhoodType Neighborhood;
+	static constexpr int NumStates = 2;
+	static constexpr int next(int state, int count)
+	{
+		return state == 1 ? (Survival >> count) & 1 : (Birth >> count) & 1;
+	}
+};
+//an alive cell that does not survive goes through the dying states 2..States-1, one per step,
+//before it is dead (0) and can be born again
+template<std::uint64_t Birth, std::uint64_t Survival, int States, class NeighborhoodType = CAMoore<1>>
+struct CAGenerationsRule {
+	static_assert( !(Birth & 1), "birth with 0 neighbors would fill the infinite plane" );
+	static_assert( States >= 2 );
+	typedef NeighborhoodType Neighborhood;
+	static constexpr int NumStates = States;
+	static constexpr int next(int state, int count)
+	{
+		if( state == 0 )
+			return (Birth >> count) & 1;
+		if( state == 1 and ((Survival >> count) & 1) )
+			return 1;
+		return state+1 < States ? state+1 : 0;
+	}
+};
+
+template<class Rule, class CellState, std::size_t Dim>
+constexpr auto caRuleTable()
+{
+	constexpr std::size_t MaxCount = caNeighborhoodSize<typename Rule::Neighborhood,Dim>();
+	static_assert( MaxCount < 64, "counts are given as 64 bit masks" );
+	std::array<std::array<CellState,MaxCount+1>,Rule::NumStates> ret{};
+	for(int state = 0; state < Rule::NumStates; ++state)
+		for(std::size_t count = 0; count <= MaxCount; ++count)
+			ret[state][count] = CellState(Rule::next(state, count));
+	return ret;
+}
+//the updateFunc of a rule: a table lookup. Cell states must be below Rule::NumStates.
+template<class Rule, class CellState, std::size_t Dim>
+struct CACompiledRule {
+	static constexpr auto table = caRuleTable<Rule,CellState,Dim>();
+	constexpr CellState operator () (CellState state, int neighborCount) const
+	{
+		return table[std::size_t(state)][neighborCount];
+	}
+};
+
+// Storage backends for CellularAutomata, selected with MyConfig::Config<CAConfigBackend, Backend>.
+// Backend::Grid<Dim,CellState,Location,AliveState,Neighborhood> provides:
+//   getCell(location)                 - a CellState&, or a proxy that converts to and assigns from CellState;
+//                                       CASparseGrid's references are invalidated by the next getCell() or step
+//   getNumberOfCellsOfState(state)
+//   doOneStep(updateFunc)
+//   doOneStep(updateFunc, pool)       - the same, using the threads of a ThreadPool
+//   forEachCell(func)                 - calls func(location, state) for every stored cell
+//   forEachCellInOrder(func)          - calls func(location, state) for every cell not in the default state,
+//                                       in order of location (row by row in 2D)
+//   optionally doSteps(updateFunc, generations), for backends that do better than stepping generations times
+
+template<class Grid, class UpdateFunc, class = std::void_t<>>
+struct ca_can_jump : std::false_type { };
+
+template<class Grid, class UpdateFunc>
+struct ca_can_jump<Grid, UpdateFunc, std::void_t<decltype(std::declval<Grid&>().doSteps(std::declval<const UpdateFunc&>(), std::uint64_t()))>> : std::true_type { };
+
+//every cell that is not in the default state CellState{} or is next to an alive cell, in a map.
+//A step only evaluates the active cells, those whose state or number of alive neighbors changed in
+//  the previous step (or through getCell()): the others get the same arguments to updateFunc as last
+//  time, so they keep their state. Stepping costs time proportional to the changes, not to the population.
+//updateFunc(CellState{}, 0) must be CellState{}, as cells that are not stored are never evaluated.
+//Defining CELLULAR_AUTOMATA_VERIFY_INCREMENTAL checks every step against a full recompute.
+struct CASparseGrid {
+	template<int Dim, class CellState, class Location, CellState AliveState, class Neighborhood>
+	class Grid {
+		//use CALocationTable if CALocationHelper can hash the location, std::unordered_map if
+		//the type Location is hashable, otherwise std::map
+		template<class Value>
+		using GridType = typename std::conditional<
+				has_ca_location_hash<Location>::value,
+				CALocationTable<Location,Value>,
+				typename std::conditional<
+					is_std_hashable_v<Location>,
+					std::unordered_map<Location,Value>,
+					std::map<Location,Value>
+				>::type
+			>::type;
+
+		GridType<CellState> cells;
+		GridType<int> neighborCount; //alive neighbors, for locations that have any
+		GridType<char> active;
+		GridType<CellState> touched; //state before getCell() handed out a reference, to find out what changed
+		std::vector<std::pair<Location,CellState>> changes;
+
+		template<class Func>
+		static void forEachNeighbor(const Location& loc, Func&& func)
+		{
+			if constexpr( std::is_same<Neighborhood,CAMoore<1>>::value )
+				CALocationHelper<Location>::forEachNeighbor(loc, func);
+			else
+				CALocationHelper<Location>::template forEachNeighborIn<Neighborhood>(loc, func);
+		}
+
+		CellState stateOf(const Location& loc) const
+		{
+			auto found = cells.find(loc);
+			return found == cells.end() ? CellState{} : found->second;
+		}
+		int countOf(const Location& loc) const
+		{
+			auto found = neighborCount.find(loc);
+			return found == neighborCount.end() ? 0 : found->second;
+		}
+		//drops loc if it is in the default state and has no alive neighbors
+		void prune(const Location& loc)
+		{
+			auto found = cells.find(loc);
+			if( found != cells.end() and found->second == CellState{} and countOf(loc) == 0 )
+				cells.erase(found);
+		}
+		void aliveChanged(const Location& loc, bool nowAlive)
+		{
+			forEachNeighbor(loc, [&](const Location& neighbor) {
+				active[neighbor] = true;
+				if( nowAlive )
+				{
+					if( neighborCount[neighbor]++ == 0 )
+						cells.emplace(neighbor, CellState{});
+				}
+				else
+				{
+					auto found = neighborCount.find(neighbor);
+					if( --found->second == 0 )
+					{
+						neighborCount.erase(found);
+						prune(neighbor);
+					}
+				}
+			});
+		}
+		//takes in the changes made through getCell()
+		void syncTouched()
+		{
+			for(auto& T : touched)
+			{
+				const CellState now = stateOf(T.first);
+				if( (T.second == AliveState) != (now == AliveState) )
+					aliveChanged(T.first, now == AliveState);
+				active[T.first] = true;
+			}
+			for(auto& T : touched)
+				prune(T.first);
+			touched.clear();
+		}
+		//the states of the next generation computed from scratch, by the rule the incremental step relies on
+		template<class UpdateFunc>
+		GridType<CellState> fullStep(const UpdateFunc& updateFunc) const
+		{
+			GridType<int> counts;
+			for(auto& C : cells)
+				if( C.second == AliveState )
+					forEachNeighbor(C.first, [&](const Location& neighbor) {counts[neighbor]++;});
+			GridType<CellState> next;
+			for(auto& C : cells)
+			{
+				auto found = counts.find(C.first);
+				next[C.first] = updateFunc(C.second, found == counts.end() ? 0 : found->second);
+			}
+			for(auto& N : counts)
+				if( !cells.count(N.first) )
+					next[N.first] = updateFunc(CellState{}, N.second);
+			return next;
+		}
+	public:
+		CellState& getCell(const Location& loc)
+		{
+			auto found = cells.find(loc);
+			touched.emplace(loc, found == cells.end() ? CellState{} : found->second);
+			return found == cells.end() ? cells[loc] : found->second;
+		}
+		int getNumberOfCellsOfState(CellState state) const
+		{
+			int count = 0;
+			for(auto& C : cells)
+				if( C.second == state )
+					++count;
+			return count;
+		}
+		template<class UpdateFunc>
+		void doOneStep(const UpdateFunc& updateFunc)
+		{
+			syncTouched();
+#ifdef CELLULAR_AUTOMATA_VERIFY_INCREMENTAL
+			const GridType<CellState> expected = fullStep(updateFunc);
+#endif
+			changes.clear();
+			for(auto& A : active)
+			{
+				const CellState cur = stateOf(A.first);
+				const CellState next = updateFunc(cur, countOf(A.first));
+				if( next != cur )
+					changes.emplace_back(A.first, next);
+			}
+			active.clear();
+			for(auto& C : changes)
+			{
+				const bool wasAlive = stateOf(C.first) == AliveState;
+				cells[C.first] = C.second;
+				active[C.first] = true;
+				if( wasAlive != (C.second == AliveState) )
+					aliveChanged(C.first, C.second == AliveState);
+				prune(C.first);
+			}
+#ifdef CELLULAR_AUTOMATA_VERIFY_INCREMENTAL
+			for(auto& E : expected)
+				assert( stateOf(E.first) == E.second );
+			for(auto& C : cells)
+			{
+				auto found = expected.find(C.first);
+				assert( C.second == (found == expected.end() ? CellState{} : found->second) );
+			}
+#endif
+		}
+		//the maps are not split between threads, so this steps serially
+		template<class UpdateFunc>
+		void doOneStep(const UpdateFunc& updateFunc, ThreadPool&)
+		{
+			doOneStep(updateFunc);
+		}
+		template<class Func>
+		void forEachCell(Func&& func) const
+		{
+			for(auto& C : cells)
+				func(C.first, C.second);
+		}
+		//the cells are not stored in order, so this sorts a copy of them
+		template<class Func>
+		void forEachCellInOrder(Func&& func) const
+		{
+			std::vector<std::pair<Location,CellState>> sorted;
+			for(auto& C : cells)
+				if( C.second != CellState{} )
+					sorted.emplace_back(C.first, C.second);
+			std::sort(sorted.begin(), sorted.end(), [](const auto& lhs, const auto& rhs) {return lhs.first < rhs.first;});
+			for(auto& C : sorted)
+				func(C.first, C.second);
+		}
+	};
+};
+
+//2D bool cells packed 64 to a word, for dense boards. location[0] is the row, location[1] the column.
+//The board grows to hold every cell that is set alive, and grows again before a step if an alive cell
+//  touches its edge; otherwise a step only swaps the two buffers, without allocating.
+//Neighbor counts of 64 cells at once are summed with full adders on whole words. The rule is tabulated
+//  from updateFunc(state, count) on every step, so updateFunc may only depend on its arguments;
+//  birth with 0 neighbors would fill the infinite plane and is ignored.
+struct CADenseBitGrid {
+	template<int Dim, class CellState, class Location, CellState AliveState, class Neighborhood>
+	class Grid {
+		static_assert( Dim == 2 and std::is_same<CellState,bool>::value and AliveState,
+				"CADenseBitGrid only holds 2D bool cells that are alive when true" );
+		static_assert( std::is_same<Neighborhood,CAMoore<1>>::value, "CADenseBitGrid only counts the 8 nearest neighbors" );
+		static_assert( std::is_same<Location,std::array<int,2>>::value );
+	public:
+		typedef std::uint64_t Word;
+		static const int WordBits = 64;
+
+		//one Word per count 0..8: all ones if a cell with that many alive neighbors is alive next step
+		struct Rule {
+			Word birth[9], survival[9];
+			template<class UpdateFunc>
+			explicit Rule(const UpdateFunc& updateFunc)
+			{
+				for(int n = 0; n < 9; ++n)
+				{
+					birth[n] = (n > 0 and updateFunc(false, n)) ? ~Word(0) : 0;
+					survival[n] = updateFunc(true, n) ? ~Word(0) : 0;
+				}
+			}
+		};
+	private:
+		//height rows of width words, surrounded by a row and a column of words that stay zero,
+		//so that neighbors can be read without bounds checks
+		std::vector<Word> words, next;
+		int height = 0, width = 0, stride = 2;
+		int originRow = 0, originWord = 0; //location of the first inner row and word; the first column is originWord*WordBits
+
+		static int floorDiv(int a, int b) {return a >= 0 ? a/b : -((-a+b-1)/b);}
+		static int popCount(Word w)
+		{
+			w = w - ((w >> 1) & 0x5555555555555555ull);
+			w = (w & 0x3333333333333333ull) + ((w >> 2) & 0x3333333333333333ull);
+			w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0full;
+			return (w * 0x0101010101010101ull) >> 56;
+		}
+		std::size_t index(int row, int word) const {return std::size_t(row+1)*stride + word+1;}
+
+		//makes the board cover rows [minRow,maxRow] and columns [minColumn,maxColumn], with room to spare
+		void reserve(int minRow, int maxRow, int minColumn, int maxColumn)
+		{
+			int minWord = floorDiv(minColumn, WordBits), maxWord = floorDiv(maxColumn, WordBits);
+			if( height > 0 )
+			{
+				if( minRow >= originRow and maxRow < originRow+height and minWord >= originWord and maxWord < originWord+width )
+					return;
+				//only grow the sides that are too small, by half the size, so that growing is amortized
+				const int rowSlack = height/2 + 1, wordSlack = width/2 + 1;
+				minRow = minRow < originRow ? minRow - rowSlack : originRow;
+				maxRow = maxRow >= originRow+height ? maxRow + rowSlack : originRow+height-1;
+				minWord = minWord < originWord ? minWord - wordSlack : originWord;
+				maxWord = maxWord >= originWord+width ? maxWord + wordSlack : originWord+width-1;
+			}
+			else
+			{
+				minRow -= 1; maxRow += 1;
+				minWord -= 1; maxWord += 1;
+			}
+
+			const int newHeight = maxRow-minRow+1, newWidth = maxWord-minWord+1;
+			std::vector<Word> grown(std::size_t(newHeight+2)*(newWidth+2), 0);
+			for(int r = 0; r < height; ++r)
+			{
+				std::size_t to = std::size_t(r+originRow-minRow+1)*(newWidth+2) + (originWord-minWord+1);
+				std::copy_n(&words[index(r,0)], width, &grown[to]);
+			}
+			words.swap(grown);
+			next.assign(words.size(), 0);
+			height = newHeight;
+			width = newWidth;
+			stride = newWidth+2;
+			originRow = minRow;
+			originWord = minWord;
+		}
+		bool touchesEdge() const
+		{
+			for(int w = 0; w < width; ++w)
+				if( words[index(0,w)] | words[index(height-1,w)] )
+					return true;
+			for(int r = 0; r < height; ++r)
+				if( (words[index(r,0)] & 1) | (words[index(r,width-1)] >> (WordBits-1)) )
+					return true;
+			return false;
+		}
+
+		class CellReference {
+			Grid& grid;
+			const Location loc;
+		public:
+			CellReference(Grid& grid, const Location& loc) : grid(grid), loc(loc) {}
+			operator bool() const {return grid.get(loc);}
+			CellReference& operator = (bool value)
+			{
+				grid.set(loc, value);
+				return *this;
+			}
+			CellReference& operator = (const CellReference& other) {return *this = bool(other);}
+		};
+	public:
+		bool get(const Location& loc) const
+		{
+			const int r = loc[0] - originRow, c = loc[1] - originWord*WordBits;
+			if( r < 0 or r >= height or c < 0 or c >= width*WordBits )
+				return false;
+			return (words[index(r, c/WordBits)] >> (c%WordBits)) & 1;
+		}
+		void set(const Location& loc, bool value)
+		{
+			if( !value and !get(loc) )
+				return;
+			reserve(loc[0], loc[0], loc[1], loc[1]);
+			const int r = loc[0] - originRow, c = loc[1] - originWord*WordBits;
+			Word& w = words[index(r, c/WordBits)];
+			if( value )
+				w |= Word(1) << (c%WordBits);
+			else
+				w &= ~(Word(1) << (c%WordBits));
+		}
+		CellReference getCell(const Location& loc)
+		{
+			return CellReference(*this, loc);
+		}
+		int getNumberOfCellsOfState(bool state) const
+		{
+			int alive = 0;
+			for(Word w : words)
+				alive += popCount(w);
+			return state ? alive : height*width*WordBits - alive;
+		}
+
+		//computes words [wordBegin,wordEnd) of row into the back buffer
+		void stepRow(int row, int wordBegin, int wordEnd, const Rule& rule)
+		{
+			const Word* up = &words[index(row-1,0)];
+			const Word* mid = &words[index(row,0)];
+			const Word* down = &words[index(row+1,0)];
+			Word* out = &next[index(row,0)];
+			for(int w = wordBegin; w < wordEnd; ++w)
+			{
+				//the column to the left of each cell is shifted in from the lower bit, the one to the right from the higher bit
+				const Word ul = (up[w] << 1) | (up[w-1] >> (WordBits-1)), ur = (up[w] >> 1) | (up[w+1] << (WordBits-1));
+				const Word ml = (mid[w] << 1) | (mid[w-1] >> (WordBits-1)), mr = (mid[w] >> 1) | (mid[w+1] << (WordBits-1));
+				const Word dl = (down[w] << 1) | (down[w-1] >> (WordBits-1)), dr = (down[w] >> 1) | (down[w+1] << (WordBits-1));
+				//rows above and below: 0..3 each, as two bits; the middle row: 0..2
+				const Word upSum = ul ^ up[w] ^ ur, upCarry = (ul & up[w]) | (ur & (ul ^ up[w]));
+				const Word downSum = dl ^ down[w] ^ dr, downCarry = (dl & down[w]) | (dr & (dl ^ down[w]));
+				const Word midSum = ml ^ mr, midCarry = ml & mr;
+				//count = bit0 + 2*bit1 + 4*bit2 + 8*bit3
+				const Word bit0 = upSum ^ downSum ^ midSum;
+				const Word twos = (upSum & downSum) | (midSum & (upSum ^ downSum));
+				const Word carrySum = upCarry ^ downCarry ^ midCarry;
+				const Word fours = (upCarry & downCarry) | (midCarry & (upCarry ^ downCarry));
+				const Word bit1 = carrySum ^ twos;
+				const Word moreFours = carrySum & twos;
+				const Word bit2 = fours ^ moreFours, bit3 = fours & moreFours;
 
+				const Word cell = mid[w];
+				Word result = 0;
+				for(int n = 0; n < 9; ++n)
+				{
+					const Word isCount = ((n & 1) ? bit0 : ~bit0) & ((n & 2) ? bit1 : ~bit1)
+						& ((n & 4) ? bit2 : ~bit2) & ((n & 8) ? bit3 : ~bit3);
+					result |= isCount & ((rule.birth[n] & ~cell) | (rule.survival[n] & cell));
+				}
+				out[w] = result;
+			}
+		}
+		//makes sure the next generation fits on the board; returns false if the board is empty
+		bool prepareStep()
+		{
+			if( height == 0 )
+				return false;
+			if( touchesEdge() )
+				reserve(originRow-1, originRow+height, originWord*WordBits-1, (originWord+width)*WordBits);
+			return true;
+		}
+		void swapBuffers()
+		{
+			words.swap(next);
+		}
+		int getHeight() const {return height;}
+		int getWidth() const {return width;}
+
+		template<class UpdateFunc>
+		void doOneStep(const UpdateFunc& updateFunc)
+		{
+			if( !prepareStep() )
+				return;
+			const Rule rule(updateFunc);
+			for(int r = 0; r < height; ++r)
+				stepRow(r, 0, width, rule);
+			swapBuffers();
+		}
+		//tiles of TileRows rows by TileWords words (32KB of each buffer) are stepped in parallel; they
+		//only write their own words of the back buffer, and read their halo from the front buffer
+		static const int TileRows = 64, TileWords = 64;
+		template<class UpdateFunc>
+		void doOneStep(const UpdateFunc& updateFunc, ThreadPool& pool)
+		{
+			if( !prepareStep() )
+				return;
+			const Rule rule(updateFunc);
+			const int tileRows = (height + TileRows-1)/TileRows, tileColumns = (width + TileWords-1)/TileWords;
+			pool.parallelFor(0, std::size_t(tileRows)*tileColumns, 1, [&](std::size_t tile) {
+				const int row = int(tile / tileColumns)*TileRows, word = int(tile % tileColumns)*TileWords;
+				const int rowEnd = std::min(height, row+TileRows), wordEnd = std::min(width, word+TileWords);
+				for(int r = row; r < rowEnd; ++r)
+					stepRow(r, word, wordEnd, rule);
+			});
+			swapBuffers();
+		}
+		//only alive cells are stored
+		template<class Func>
+		void forEachCell(Func&& func) const
+		{
+			for(int r = 0; r < height; ++r)
+				for(int w = 0; w < width; ++w)
+					for(Word bits = words[index(r,w)]; bits; bits &= bits-1)
+					{
+						const Location loc{originRow + r, (originWord + w)*WordBits + popCount((bits & (~bits+1)) - 1)};
+						func(loc, true);
+					}
+		}
+		//forEachCell() already goes row by row
+		template<class Func>
+		void forEachCellInOrder(Func&& func) const
+		{
+			forEachCell(func);
+		}
+	};
+};
+
+/*
+   Game of Life on a dense board, stepped by every core, reporting cell updates per second:
+
+	CellularAutomata<MyConfig::Config<CAConfigBackend,CADenseBitGrid>> life([](bool alive, int n) {return n == 3 or (alive and n == 2);});
+	for(auto& L : soup)
+		life.getCell(L) = true;
+	ThreadPool pool;
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < steps; ++i)
+		life.doOneStep(pool);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << double(life.getNumberOfCellsOfState(true) + life.getNumberOfCellsOfState(false)) * steps / seconds << " cell updates/s\n";
+*/
 template<class... Args>
 class CellularAutomata {
 	static const int Dim = MyConfig::GetValueOrDefault<CAConfigDim, 2, Args...>::value;
 	using CellState = typename MyConfig::GetTypeOrDefault<CAConfigCellState, bool, Args...>::type;
 	using Location = typename MyConfig::GetTypeOrDefault<CAConfigLocation, std::array<int,Dim>, Args...>::type;
 	static const CellState AliveState = MyConfig::GetValueOrDefault<CAConfigAliveState, true, Args...>::value;
+	using Backend = typename MyConfig::GetTypeOrDefault<CAConfigBackend, CASparseGrid, Args...>::type;
+	using Rule = typename MyConfig::GetTypeOrDefault<CAConfigRule, void, Args...>::type;
 
-	//use std::unordered_map if the type Value is hashable, otherwise use std::map
-	template<class Value>
-	using GridType = typename std::conditional<
-			is_std_hashable_v<Location>,
-			std::unordered_map<Location,Value>,
-			std::map<Location,Value>
-		>::type;
+	template<class R, class = void>
+	struct RuleTraits {
+		using Neighborhood = CAMoore<1>;
+		using UpdateFunc = std::function<CellState(CellState curState, int neighborCount)>;
+	};
+	template<class R>
+	struct RuleTraits<R, std::enable_if_t<!std::is_void<R>::value>> {
+		using Neighborhood = typename R::Neighborhood;
+		using UpdateFunc = CACompiledRule<R,CellState,Dim>;
+	};
+	using UpdateFunc = typename RuleTraits<Rule>::UpdateFunc;
+	using GridType = typename Backend::template Grid<Dim,CellState,Location,AliveState,typename RuleTraits<Rule>::Neighborhood>;
 
-	GridType<CellState> cells;
-	const std::function<CellState(CellState curState, int neighborCount)> updateFunc;
+	GridType cells;
+	const UpdateFunc updateFunc;
 public:
-	CellularAutomata(decltype(updateFunc) func) : updateFunc(func) {}
-	CellState& getCell(Location loc)
+	CellularAutomata(UpdateFunc func) : updateFunc(func) {}
+	//for a CAConfigRule
+	template<class R = Rule, class = std::enable_if_t<!std::is_void<R>::value>>
+	CellularAutomata() : updateFunc() {}
+	//a reference (or proxy) to the cell, to read or assign. With CASparseGrid it points into a CALocationTable slot, which
+	//moves whenever a cell is added or removed: it is only valid until the next call to getCell() or step, so
+	//	getCell(a) = getCell(b);   //not with CASparseGrid: getCell(b) may move a's slot
+	//must copy the state first: CellState s = getCell(b); getCell(a) = s;
+	decltype(auto) getCell(Location loc)
 	{
-		return cells[loc];
+		return cells.getCell(loc);
 	}
 	int getNumberOfCellsOfState(CellState state)
 	{
-		int count = 0;
-		for(auto C : cells)
-			if( C.second == state )
-				++count;
-		return count;
+		return cells.getNumberOfCellsOfState(state);
 	}
 	void doOneStep()
 	{
-		//calculate neighbor counts
-		GridType<int> neighborCount;
-		for(auto C : cells)
-		{
-			if( C.second != AliveState ) continue;
-			CALocationHelper<Location>::addNeighborCounts(neighborCount, C.first);
-		}
-		//update based on user-supplied function
-		decltype(cells) next;
-		for(auto N : neighborCount)
-		{
-			next[N.first] = updateFunc(cells[N.first], N.second);
-		}
-		cells = next;
+		cells.doOneStep(updateFunc);
+	}
+	//same result as doOneStep(), with the work split between the threads of pool
+	void doOneStep(ThreadPool& pool)
+	{
+		cells.doOneStep(updateFunc, pool);
+	}
+	//advances generations steps; backends like CAHashlife jump ahead instead of stepping one at a time
+	void doSteps(std::uint64_t generations)
+	{
+		if constexpr( ca_can_jump<GridType,UpdateFunc>::value )
+			cells.doSteps(updateFunc, generations);
+		else
+			for(std::uint64_t i = 0; i < generations; ++i)
+				cells.doOneStep(updateFunc);
 	}
 	multi_vector_t<CellState,Dim> locationMap()
 	{
 		multi_vector_t<CellState,Dim> ret;
 		std::array<int,Dim> minDims, maxDims;
-		minDims.fill(10000);
-		maxDims.fill(-10000);
-		for(auto C : cells)
-		{
-			if( C.second != AliveState ) continue;
+		minDims.fill(std::numeric_limits<int>::max());
+		maxDims.fill(std::numeric_limits<int>::min());
+		bool any = false;
+		cells.forEachCell([&](const Location& loc, CellState state) {
+			if( state != AliveState ) return;
+			any = true;
 			for(int d = 0; d < Dim; ++d)
 			{
-				minDims.at(d) = std::min(minDims.at(d), C.first.at(d));
-				maxDims.at(d) = std::max(maxDims.at(d), C.first.at(d));
+				minDims.at(d) = std::min(minDims.at(d), loc.at(d));
+				maxDims.at(d) = std::max(maxDims.at(d), loc.at(d));
 			}
-		}
+		});
+		if( !any )
+			return ret;
 		std::array<int,Dim> len;
 		for(int i = 0; i < Dim; ++i)
 		{
 			len.at(Dim-i-1) = maxDims.at(i) - minDims.at(i) + 1;
 		}
 		recursive_resize<Dim-1>(ret, len);
-		for(auto C : cells)
-		{
-			if( C.second != AliveState ) continue;
-			auto loc = C.first;
+		cells.forEachCell([&](Location loc, CellState state) {
+			if( state != AliveState ) return;
 			for(int i = 0; i < Dim; ++i)
 				loc.at(i) -= minDims.at(i);
-			getElement(ret, loc) = C.second;
-		}
+			getElement(ret, loc) = state;
+		});
 		return ret;
 	}
-};
 
-#include "MultiForVar.h"
+	//Writes a 2D board as RLE, in pieces of about 64KB to sink(std::string_view), so that large boards need
+	//  no more memory than that (except for CASparseGrid, which sorts its cells first).
+	//The position of the top left cell is given in a "#CXRLE Pos=column,row" line, and the cells
+	//  of each row as runs of b (dead) and o (alive), or . and A-X for 0 and states 1-24 of non-bool cells;
+	//  other states have no symbol, and throw std::out_of_range before anything is written.
+	template<class Sink, class = std::enable_if_t<!std::is_base_of<std::ostream,std::decay_t<Sink>>::value>>
+	void writeRLE(Sink&& sink)
+	{
+		static_assert( Dim == 2, "RLE holds 2D boards" );
+		int minRow = std::numeric_limits<int>::max(), maxRow = std::numeric_limits<int>::min();
+		int minColumn = minRow, maxColumn = maxRow;
+		cells.forEachCell([&](const Location& loc, CellState state) {
+			if( state == CellState{} ) return;
+			if constexpr( !std::is_same<CellState,bool>::value )
+				if( int(state) < 1 or int(state) > 24 )
+					throw std::out_of_range("RLE only holds cell states 0 to 24!");
+			minRow = std::min(minRow, loc[0]); maxRow = std::max(maxRow, loc[0]);
+			minColumn = std::min(minColumn, loc[1]); maxColumn = std::max(maxColumn, loc[1]);
+		});
+		std::string out;
+		if( minRow > maxRow )
+		{
+			out = "x = 0, y = 0\n!\n";
+			sink(std::string_view(out));
+			return;
+		}
+		out = "#CXRLE Pos=" + std::to_string(minColumn) + "," + std::to_string(minRow) + "\n"
+			"x = " + std::to_string(std::int64_t(maxColumn) - minColumn + 1) +
+			", y = " + std::to_string(std::int64_t(maxRow) - minRow + 1) + "\n";
+
+		std::size_t lineLength = 0;
+		auto emit = [&](std::int64_t count, char tag) {
+			char text[24];
+			std::size_t length = 0;
+			if( count > 1 )
+				length = std::snprintf(text, sizeof(text), "%lld", (long long)count);
+			text[length++] = tag;
+			if( lineLength + length > 70 )
+			{
+				out += '\n';
+				lineLength = 0;
+			}
+			out.append(text, length);
+			lineLength += length;
+			if( out.size() >= (1 << 16) )
+			{
+				sink(std::string_view(out));
+				out.clear();
+			}
+		};
+		auto tagOf = [](CellState state) -> char {
+			if constexpr( std::is_same<CellState,bool>::value )
+				return state ? 'o' : 'b';
+			else
+				return state == CellState{} ? '.' : char('A' + int(state) - 1);
+		};
+		std::int64_t row = minRow, column = minColumn, runLength = 0;
+		CellState runState{};
+		auto addRun = [&](CellState state, std::int64_t length) {
+			if( runLength and state == runState )
+			{
+				runLength += length;
+				return;
+			}
+			if( runLength )
+				emit(runLength, tagOf(runState));
+			runState = state;
+			runLength = length;
+		};
+		cells.forEachCellInOrder([&](const Location& loc, CellState state) {
+			if( state == CellState{} ) return;
+			if( loc[0] != row )
+			{
+				if( runLength )
+					emit(runLength, tagOf(runState));
+				runLength = 0;
+				emit(loc[0] - row, '$');
+				row = loc[0];
+				column = minColumn;
+			}
+			if( loc[1] > column )
+				addRun(CellState{}, loc[1] - column);
+			addRun(state, 1);
+			column = std::int64_t(loc[1]) + 1;
+		});
+		if( runLength )
+			emit(runLength, tagOf(runState));
+		emit(1, '!');
+		out += '\n';
+		sink(std::string_view(out));
+	}
+	void writeRLE(std::ostream& out)
+	{
+		writeRLE([&](std::string_view piece) {out.write(piece.data(), piece.size());});
+	}
+	//sets the cells of RLE written by writeRLE() or other programs (without a Pos line, the top left cell goes to {0,0});
+	//cells that are not mentioned are left as they are
+	void readRLE(std::istream& in)
+	{
+		static_assert( Dim == 2, "RLE holds 2D boards" );
+		int originRow = 0, originColumn = 0;
+		std::string line;
+		while( std::getline(in, line) )
+		{
+			if( line.empty() or line[0] == '#' )
+			{
+				std::size_t pos = line.find("Pos=");
+				if( line.compare(0, 6, "#CXRLE") == 0 and pos != std::string::npos )
+					std::sscanf(line.c_str() + pos + 4, "%d,%d", &originColumn, &originRow);
+				continue;
+			}
+			if( line[0] == 'x' ) //the size and rule are not needed
+				continue;
+			break;
+		}
+		int row = originRow, column = originColumn;
+		std::int64_t count = 0;
+		do {
+			for(char c : line)
+			{
+				if( c >= '0' and c <= '9' )
+				{
+					count = count*10 + (c - '0');
+					continue;
+				}
+				const int n = count ? int(count) : 1;
+				count = 0;
+				if( c == 'b' or c == '.' )
+					column += n;
+				else if( c == 'o' or (c >= 'A' and c <= 'X') )
+				{
+					const CellState state = CellState(c == 'o' ? 1 : c - 'A' + 1);
+					for(int i = 0; i < n; ++i)
+						getCell(Location{row, column++}) = state;
+				}
+				else if( c == '$' )
+				{
+					row += n;
+					column = originColumn;
+				}
+				else if( c == '!' )
+					return;
+				else if( c != ' ' and c != '\t' and c != '\r' )
+					throw std::runtime_error(std::string("Unexpected character '") + c + "' in RLE!");
+			}
+		} while( std::getline(in, line) );
+	}
+};
 
 template<std::size_t Dim>
 struct CALocationHelper<std::array<int,Dim>> {
 	typedef std::array<int,Dim> T;
-	static constexpr void addNeighborCounts(std::unordered_map<T,int>& neighborCounts, const T& location)
+	template<class Neighborhood>
+	static constexpr auto Offsets = caNeighborhoodOffsets<Neighborhood,Dim>();
+
+	template<class Neighborhood, class Func, std::size_t... I>
+	static constexpr void forEachOffset(const T& location, Func& func, std::index_sequence<I...>)
 	{
-		std::array<int,Dim> start{}, end{};
-		start.fill(-1);
-		end.fill(1+1); // go from [-1,2)
-		for(MultiForVar<Dim> F(start,end); !F.done(); ++F)
-		{
-			bool isSelf = true;
-			for(int i = 0; i < Dim; ++i)
-				if( F.index(i) != 0 )
-					isSelf = false;
-			if( isSelf ) continue;
-			auto neighborLoc = location;
-			for(int i = 0; i < Dim; ++i)
-				neighborLoc[i] += F.index(i);
-			neighborCounts[neighborLoc]++;
-		}
+		(func(shifted(location, Offsets<Neighborhood>[I])), ...);
+	}
+	static constexpr T shifted(T location, const T& offset)
+	{
+		for(std::size_t i = 0; i < Dim; ++i)
+			location[i] += offset[i];
+		return location;
+	}
+
+	static std::uint64_t hash(const T& location)
+	{
+		std::uint64_t h = 0;
+		for(std::size_t i = 0; i < Dim; ++i)
+			h = (h ^ std::uint32_t(location[i])) * 0xff51afd7ed558ccdull + i;
+		return h ^ (h >> 29);
+	}
+	//unrolled over the neighbors at compile time
+	template<class Neighborhood, class Func>
+	static constexpr void forEachNeighborIn(const T& location, Func&& func)
+	{
+		forEachOffset<Neighborhood>(location, func, std::make_index_sequence<Offsets<Neighborhood>.size()>{});
+	}
+	template<class Func>
+	static constexpr void forEachNeighbor(const T& location, Func&& func)
+	{
+		forEachNeighborIn<CAMoore<1>>(location, func);
+	}
+	template<class Map>
+	static constexpr void addNeighborCounts(Map& neighborCounts, const T& location)
+	{
+		forEachNeighbor(location, [&](const T& neighborLoc) {neighborCounts[neighborLoc]++;});
 	}
 };
 
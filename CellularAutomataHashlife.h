@@ -0,0 +1,407 @@
+#ifndef CELLULAR_AUTOMATA_HASHLIFE_H__
+#define CELLULAR_AUTOMATA_HASHLIFE_H__
+
+#include "CellularAutomata.h"
+
+#include <climits>
+#include <deque>
+#include <stdexcept>
+
+/*
+   Hashlife backend for 2D bool CellularAutomata:
+
+	CellularAutomata<MyConfig::Config<CAConfigBackend,CAHashlife>> life([](bool alive, int n) {return n == 3 or (alive and n == 2);});
+	life.getCell({0,1}) = true; life.getCell({1,2}) = true; life.getCell({2,0}) = life.getCell({2,1}) = life.getCell({2,2}) = true;
+	life.doSteps(std::uint64_t(1) << 24); //the glider is now 2^22 cells away
+
+   The board is a quadtree whose nodes are hash-consed: every distinct square of cells exists once, no
+     matter how often it appears, in space or in time. A node of level L (2^L cells wide) remembers its
+	 center, 2^(L-1) cells wide, a fixed number of generations later. Regular patterns repeat the same
+	 nodes, so after the first few the results come from memory, and doSteps(2^k) takes time roughly
+	 proportional to the number of distinct nodes rather than to the generations or cells.
+   Every node that was ever built is kept until there are more than nodeLimit, after which the nodes
+     not reachable from the board are dropped, along with all memoized results.
+   location[0] is the row and location[1] the column, as for CADenseBitGrid; the rule is tabulated
+     from updateFunc(state, count) in the same way, and birth with 0 neighbors is ignored.
+   The board itself may grow far wider than an int, but the cells that are alive must stay within
+     int locations to be read back.
+*/
+
+struct CAHashlife {
+	template<int Dim, class CellState, class Location, CellState AliveState, class Neighborhood>
+	class Grid {
+		static_assert( Dim == 2 and std::is_same<CellState,bool>::value and AliveState,
+				"CAHashlife only holds 2D bool cells that are alive when true" );
+		static_assert( std::is_same<Neighborhood,CAMoore<1>>::value, "CAHashlife only counts the 8 nearest neighbors" );
+		static_assert( std::is_same<Location,std::array<int,2>>::value );
+
+		struct Node {
+			Node* nw; Node* ne; Node* sw; Node* se; //null for the two leaves, the single cells
+			int level;
+			std::uint64_t population;
+			Node* result; //the center after 2^min(level-2,stepLog) generations, once computed
+		};
+		typedef std::array<Node*,4> Key;
+		struct KeyHash {
+			std::size_t operator () (const Key& key) const
+			{
+				std::size_t h = 0;
+				for(Node* N : key)
+					h = (h ^ std::hash<Node*>()(N)) * 0x100000001b3ull;
+				return h;
+			}
+		};
+
+		std::deque<Node> nodes;
+		std::unordered_map<Key,Node*,KeyHash> table;
+		std::vector<Node*> emptyNodes; //emptyNodes[L]: the empty node of level L
+		Node* dead;
+		Node* alive;
+		Node* root;
+		bool birth[9], survival[9];
+		int stepLog = 0; //memoized results advance 2^stepLog generations (less for small nodes)
+		std::size_t nodeLimit = std::size_t(1) << 22;
+
+		Node* leaf(bool value) {return value ? alive : dead;}
+		Node* join(Node* nw, Node* ne, Node* sw, Node* se)
+		{
+			auto found = table.find(Key{nw,ne,sw,se});
+			if( found != table.end() )
+				return found->second;
+			nodes.push_back(Node{nw, ne, sw, se, nw->level+1,
+					nw->population + ne->population + sw->population + se->population, nullptr});
+			Node* ret = &nodes.back();
+			table.emplace(Key{nw,ne,sw,se}, ret);
+			return ret;
+		}
+		Node* empty(int level)
+		{
+			while( int(emptyNodes.size()) <= level )
+			{
+				Node* E = emptyNodes.back();
+				emptyNodes.push_back(join(E, E, E, E));
+			}
+			return emptyNodes[level];
+		}
+		//the same cells, in a node twice as wide
+		Node* expand(Node* n)
+		{
+			Node* E = empty(n->level-1);
+			return join(join(E, E, E, n->nw), join(E, E, n->ne, E), join(E, n->sw, E, E), join(n->se, E, E, E));
+		}
+		//half as wide squares between two nodes, or in the middle of one
+		Node* centerHorizontal(Node* w, Node* e) {return join(w->ne, e->nw, w->se, e->sw);}
+		Node* centerVertical(Node* n, Node* s) {return join(n->sw, n->se, s->nw, s->ne);}
+		Node* center(Node* n) {return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);}
+
+		bool cellOf(Node* n, int row, int column) const //within a node of level 2
+		{
+			Node* quadrant = row < 2 ? (column < 2 ? n->nw : n->ne) : (column < 2 ? n->sw : n->se);
+			row &= 1; column &= 1;
+			Node* cell = row == 0 ? (column == 0 ? quadrant->nw : quadrant->ne) : (column == 0 ? quadrant->sw : quadrant->se);
+			return cell == alive;
+		}
+		//a 4x4 node's center one generation later
+		Node* advanceBase(Node* n)
+		{
+			bool next[2][2];
+			for(int r = 1; r <= 2; ++r)
+				for(int c = 1; c <= 2; ++c)
+				{
+					int count = 0;
+					for(int dr = -1; dr <= 1; ++dr)
+						for(int dc = -1; dc <= 1; ++dc)
+							if( (dr or dc) and cellOf(n, r+dr, c+dc) )
+								++count;
+					next[r-1][c-1] = cellOf(n, r, c) ? survival[count] : birth[count];
+				}
+			return join(leaf(next[0][0]), leaf(next[0][1]), leaf(next[1][0]), leaf(next[1][1]));
+		}
+		//n's center, 2^min(level-2,stepLog) generations later
+		Node* advance(Node* n)
+		{
+			if( n->result )
+				return n->result;
+			Node* ret;
+			if( n->population == 0 )
+				ret = empty(n->level-1);
+			else if( n->level == 2 )
+				ret = advanceBase(n);
+			else
+			{
+				Node* sub[9] = {
+					n->nw, centerHorizontal(n->nw, n->ne), n->ne,
+					centerVertical(n->nw, n->sw), center(n), centerVertical(n->ne, n->se),
+					n->sw, centerHorizontal(n->sw, n->se), n->se
+				};
+				//at full speed both halves advance; otherwise the first half only moves to the center
+				const bool fullSpeed = n->level-2 <= stepLog;
+				for(auto& S : sub)
+					S = fullSpeed ? advance(S) : center(S);
+				ret = join(
+					advance(join(sub[0], sub[1], sub[3], sub[4])),
+					advance(join(sub[1], sub[2], sub[4], sub[5])),
+					advance(join(sub[3], sub[4], sub[6], sub[7])),
+					advance(join(sub[4], sub[5], sub[7], sub[8])));
+			}
+			n->result = ret;
+			return ret;
+		}
+
+		//cells alive within the middle half of the root, so that its result holds all of the next generations
+		bool centered() const
+		{
+			return root->nw->population == root->nw->se->se->population
+				and root->ne->population == root->ne->sw->sw->population
+				and root->sw->population == root->sw->ne->ne->population
+				and root->se->population == root->se->nw->nw->population;
+		}
+		std::int64_t halfWidth() const {return std::int64_t(1) << (root->level-1);}
+		bool contains(const Location& loc) const
+		{
+			return loc[0] >= -halfWidth() and loc[0] < halfWidth() and loc[1] >= -halfWidth() and loc[1] < halfWidth();
+		}
+		Node* setCell(Node* n, std::int64_t row, std::int64_t column, bool value) //row and column within n
+		{
+			if( n->level == 0 )
+				return leaf(value);
+			const std::int64_t half = std::int64_t(1) << (n->level-1);
+			if( row < half )
+				return column < half
+					? join(setCell(n->nw, row, column, value), n->ne, n->sw, n->se)
+					: join(n->nw, setCell(n->ne, row, column-half, value), n->sw, n->se);
+			return column < half
+				? join(n->nw, n->ne, setCell(n->sw, row-half, column, value), n->se)
+				: join(n->nw, n->ne, n->sw, setCell(n->se, row-half, column-half, value));
+		}
+		template<class Func>
+		void forEachAlive(Node* n, std::int64_t row, std::int64_t column, Func& func) const
+		{
+			if( n->population == 0 )
+				return;
+			if( n->level == 0 )
+			{
+				func(Location{int(row), int(column)}, true);
+				return;
+			}
+			const std::int64_t half = std::int64_t(1) << (n->level-1);
+			forEachAlive(n->nw, row, column, func);
+			forEachAlive(n->ne, row, column+half, func);
+			forEachAlive(n->sw, row+half, column, func);
+			forEachAlive(n->se, row+half, column+half, func);
+		}
+
+		void rowBounds(Node* n, std::int64_t row, std::int64_t& minRow, std::int64_t& maxRow) const
+		{
+			if( n->population == 0 )
+				return;
+			if( n->level == 0 )
+			{
+				minRow = std::min(minRow, row);
+				maxRow = std::max(maxRow, row);
+				return;
+			}
+			const std::int64_t half = std::int64_t(1) << (n->level-1);
+			rowBounds(n->nw, row, minRow, maxRow);
+			rowBounds(n->ne, row, minRow, maxRow);
+			rowBounds(n->sw, row+half, minRow, maxRow);
+			rowBounds(n->se, row+half, minRow, maxRow);
+		}
+		//row is within n, and location its row on the board
+		template<class Func>
+		void forEachAliveInRow(Node* n, std::int64_t row, std::int64_t column, std::int64_t location, Func& func) const
+		{
+			if( n->population == 0 )
+				return;
+			if( n->level == 0 )
+			{
+				func(Location{int(location), int(column)}, true);
+				return;
+			}
+			const std::int64_t half = std::int64_t(1) << (n->level-1);
+			if( row < half )
+			{
+				forEachAliveInRow(n->nw, row, column, location, func);
+				forEachAliveInRow(n->ne, row, column+half, location, func);
+			}
+			else
+			{
+				forEachAliveInRow(n->sw, row-half, column, location, func);
+				forEachAliveInRow(n->se, row-half, column+half, location, func);
+			}
+		}
+
+		template<class UpdateFunc>
+		void setRule(const UpdateFunc& updateFunc)
+		{
+			bool changed = false;
+			for(int n = 0; n < 9; ++n)
+			{
+				const bool b = n > 0 and updateFunc(false, n), s = updateFunc(true, n);
+				changed = changed or b != birth[n] or s != survival[n];
+				birth[n] = b;
+				survival[n] = s;
+			}
+			if( changed )
+				clearResults();
+		}
+		void setStepLog(int log)
+		{
+			if( log != stepLog )
+				clearResults();
+			stepLog = log;
+		}
+		void clearResults()
+		{
+			for(auto& N : nodes)
+				N.result = nullptr;
+		}
+		//rebuilds the table with only the nodes of the board
+		void collect()
+		{
+			std::deque<Node> oldNodes;
+			oldNodes.swap(nodes);
+			table.clear();
+			std::unordered_map<Node*,Node*> moved;
+			nodes.push_back(Node{nullptr, nullptr, nullptr, nullptr, 0, 0, nullptr});
+			nodes.push_back(Node{nullptr, nullptr, nullptr, nullptr, 0, 1, nullptr});
+			moved[dead] = &nodes[0];
+			moved[alive] = &nodes[1];
+			dead = &nodes[0];
+			alive = &nodes[1];
+			auto copy = [&](auto& self, Node* n) -> Node* {
+				auto found = moved.find(n);
+				if( found != moved.end() )
+					return found->second;
+				Node* ret = join(self(self, n->nw), self(self, n->ne), self(self, n->sw), self(self, n->se));
+				moved.emplace(n, ret);
+				return ret;
+			};
+			root = copy(copy, root);
+			emptyNodes.assign(1, dead);
+			nodeLimit = std::max(nodeLimit, 2*nodes.size());
+		}
+
+		//coordinates are int64 offsets of up to halfWidth() from the center
+		static constexpr int MaxLevel = 63;
+
+		//advances 2^log generations
+		void step(int log)
+		{
+			assert( log+3 <= MaxLevel );
+			setStepLog(log);
+			while( root->level < log+3 or !centered() )
+			{
+				if( root->level == MaxLevel )
+					throw std::overflow_error("CAHashlife pattern outgrew 64-bit coordinates!");
+				root = expand(root);
+			}
+			root = advance(root);
+			if( nodes.size() > nodeLimit )
+				collect();
+		}
+
+		class CellReference {
+			Grid& grid;
+			const Location loc;
+		public:
+			CellReference(Grid& grid, const Location& loc) : grid(grid), loc(loc) {}
+			operator bool() const {return grid.get(loc);}
+			CellReference& operator = (bool value)
+			{
+				grid.set(loc, value);
+				return *this;
+			}
+			CellReference& operator = (const CellReference& other) {return *this = bool(other);}
+		};
+	public:
+		Grid()
+		{
+			nodes.push_back(Node{nullptr, nullptr, nullptr, nullptr, 0, 0, nullptr});
+			nodes.push_back(Node{nullptr, nullptr, nullptr, nullptr, 0, 1, nullptr});
+			dead = &nodes[0];
+			alive = &nodes[1];
+			emptyNodes.push_back(dead);
+			root = empty(3);
+			std::fill(std::begin(birth), std::end(birth), false);
+			std::fill(std::begin(survival), std::end(survival), false);
+		}
+		Grid(const Grid&) = delete;
+		Grid& operator = (const Grid&) = delete;
+
+		bool get(const Location& loc) const
+		{
+			if( !contains(loc) )
+				return false;
+			Node* n = root;
+			std::int64_t row = loc[0] + halfWidth(), column = loc[1] + halfWidth();
+			while( n->level > 0 and n->population )
+			{
+				const std::int64_t half = std::int64_t(1) << (n->level-1);
+				n = row < half ? (column < half ? n->nw : n->ne) : (column < half ? n->sw : n->se);
+				row &= half-1;
+				column &= half-1;
+			}
+			return n == alive;
+		}
+		void set(const Location& loc, bool value)
+		{
+			if( get(loc) == value )
+				return;
+			while( !contains(loc) )
+				root = expand(root);
+			root = setCell(root, loc[0] + halfWidth(), loc[1] + halfWidth(), value);
+		}
+		CellReference getCell(const Location& loc)
+		{
+			return CellReference(*this, loc);
+		}
+		//dead cells are counted within the current root square only
+		int getNumberOfCellsOfState(bool state) const
+		{
+			if( state )
+				return int(root->population);
+			const std::uint64_t area = std::uint64_t(1) << std::min(2*root->level, 62);
+			return int(std::min<std::uint64_t>(area - root->population, INT_MAX));
+		}
+		template<class UpdateFunc>
+		void doOneStep(const UpdateFunc& updateFunc)
+		{
+			doSteps(updateFunc, 1);
+		}
+		//memoized results are shared between threads only through the table, so this steps serially
+		template<class UpdateFunc>
+		void doOneStep(const UpdateFunc& updateFunc, ThreadPool&)
+		{
+			doOneStep(updateFunc);
+		}
+		//one jump per set bit of generations, largest first; the root of a jump of 2^log generations is at
+		//least of level log+3, so generations must be less than 2^(MaxLevel-2)
+		template<class UpdateFunc>
+		void doSteps(const UpdateFunc& updateFunc, std::uint64_t generations)
+		{
+			if( generations >> (MaxLevel-2) )
+				throw std::overflow_error("CAHashlife cannot step 2^61 generations or more!");
+			setRule(updateFunc);
+			for(int log = 63; log >= 0; --log)
+				if( (generations >> log) & 1 )
+					step(log);
+		}
+		template<class Func>
+		void forEachCell(Func&& func) const
+		{
+			forEachAlive(root, -halfWidth(), -halfWidth(), func);
+		}
+		//one row at a time, within the rows that have alive cells
+		template<class Func>
+		void forEachCellInOrder(Func&& func) const
+		{
+			std::int64_t minRow = halfWidth(), maxRow = -halfWidth();
+			rowBounds(root, -halfWidth(), minRow, maxRow);
+			for(std::int64_t row = minRow; row <= maxRow; ++row)
+				forEachAliveInRow(root, row + halfWidth(), -halfWidth(), row, func);
+		}
+	};
+};
+
+#endif /* CELLULAR_AUTOMATA_HASHLIFE_H__ */
@@ -48,6 +48,10 @@ public:
 If a valid parsing cannot be completed (either because the token did not match, or any other reason), a ParsedToken<Type>() must be returned to signal that the parsing
 did not complete successfully.
 
+Commands are looked up by name through a hash index, so execute() costs the same no matter how many commands are
+registered. Once all commands have been added, CommandParser::freeze() replaces the index with a perfect hash of the command names;
+adding another command afterwards simply drops back to the regular index.
+
 Additionally, a help string that lists the valid commands along with their arguments and descriptions is available as the return value of function CommandParser::getHelpString();
 For the above example, this would return a string with the following contents:
 
@@ -160,28 +164,43 @@ userTypeFunction() called.
 #ifndef _COMMAND_PARSER_HPP__
 #define _COMMAND_PARSER_HPP__
 
-#ifndef __GXX_EXPERIMENTAL_CXX0X__
-#error CommandParser.hpp requires --std=c++0x!
+#if __cplusplus < 201703L
+#error CommandParser.hpp requires --std=c++17!
 #else
 
 #include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
 #include <sstream>
 #include <string>
-#include <iomanip>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <stdexcept>
 
+#include "ThreadPool.h"
+
 //A class that contains a parsed token. If parsing failed, isValid() returns false, and getValue() cannot be called. If parsing
 //succeeded, then isValid() returns true and getValue() can be called.
 //It is not necessary to specialize this template.
 template<class T>
 class ParsedToken {
-	std::shared_ptr<T> value;
+	std::optional<T> value; //held in place, parsing a token does not allocate
 public:
-	ParsedToken() : value(NULL) {}
-	ParsedToken(T v) : value(new T(v)) {}
-	bool isValid() {return value != NULL;}
+	ParsedToken() {}
+	ParsedToken(T v) : value(std::move(v)) {}
+	bool isValid() {return value.has_value();}
 	T getValue() {if(!isValid()) throw std::runtime_error("Cannot convert incorrectly parsed token!"); return *value;}
+	//same as getValue(), but moves the value out of the token
+	T takeValue() {if(!isValid()) throw std::runtime_error("Cannot convert incorrectly parsed token!"); return std::move(*value);}
 };
 
 
@@ -192,13 +211,29 @@ template<class T>	class TokenParser {
 		const static bool value = false;
 	};
 public:
-  //In your specialization, you must have a static function parse() that takes a std::string and returns a ParsedToken<SameTypeAsSpecialization>
+  //In your specialization, you must have a static function parse() that takes a std::string (or a std::string_view, which
+  //saves a copy of every token) and returns a ParsedToken<SameTypeAsSpecialization>
   static ParsedToken<T> parse(std::string)
 	{
 		static_assert(always_false<T>::value, "You must specialize TokenParser<> with the type listed above as T in order to use CommandParser - see comments at top of CommandParser.hpp for example.");
 	}
 };
 
+template<class T, class = void>
+struct TokenParserTakesStringView : std::false_type {};
+template<class T>
+struct TokenParserTakesStringView<T, std::void_t<decltype(TokenParser<T>::parse(std::declval<std::string_view>()))>> : std::true_type {};
+
+//calls TokenParser<T>::parse with the token, only copying it into a std::string if the parser needs one
+template<class T>
+ParsedToken<T> parseToken(std::string_view token)
+{
+	if constexpr (TokenParserTakesStringView<T>::value)
+		return TokenParser<T>::parse(token);
+	else
+		return TokenParser<T>::parse(std::string(token));
+}
+
 //This class facilitates getting a human-readable name from a type. If a specific string is needed,
 //a specialization can be created that returns the specific string needed - see specializations for bool,
 //int, and std::string below for an example.
@@ -235,202 +270,731 @@ public:
   static std::string get() {return "string";}
 };
 
+//Splits the next whitespace separated token off the front of str, the same way operator>> on a stream would.
+//Returns an empty token if there is none left.
+inline std::string_view nextToken(std::string_view& str)
+{
+	auto isSpace = [](char c) {return c == ' ' or c == '\t' or c == '\n' or c == '\r' or c == '\v' or c == '\f';};
+	std::size_t begin = 0;
+	while( begin < str.size() and isSpace(str[begin]) )
+		++begin;
+	std::size_t end = begin;
+	while( end < str.size() and !isSpace(str[end]) )
+		++end;
+	std::string_view token = str.substr(begin, end-begin);
+	str.remove_prefix(end);
+	return token;
+}
+
 //Base class of a command
 class CommandOptionBase {
 	std::string commandName;
   std::string description;
+	bool commutative = false;
+	std::mutex parseMutex; //see bind()
 public:
   CommandOptionBase(std::string c, std::string d) : commandName(c), description(d) {}
-  std::string getCommandName() {return commandName;}
+	virtual ~CommandOptionBase() {}
+  const std::string& getCommandName() {return commandName;}
 	std::string getDescription() {return description;}
+	//commutative commands may run concurrently, and in any order, with the commutative commands next to them (see CommandParser::executeStream())
+	bool isCommutative() {return commutative;}
+	void setCommutative(bool c) {commutative = c;}
 	virtual std::string getArgumentString()=0;
 	//parse returns true if parsing succeeded, otherwise returns false
 	//parse will always be called before exec, allowing parsed values to be saved
-	virtual bool parse(std::string)=0;
+	virtual bool parse(std::string_view)=0;
 	//executes the command
 	virtual void exec()=0;
+	//parses the arguments and, if that succeeded, executes the command; returns whether it was executed.
+	//Commands can override this to parse into temporaries instead of saving the parsed values.
+	virtual bool tryExecute(std::string_view optionStr)
+	{
+		if( !parse(optionStr) )
+			return false;
+		exec();
+		return true;
+	}
+	//parses the arguments and returns a function that executes the command with them, or an empty function if they do not
+	//parse. Commands should override this to bind the parsed values; by default the arguments are parsed again on each call,
+	//and as parse() and exec() share the saved values, both hold parseMutex so that bind() and the calls can run on any thread.
+	virtual std::function<void()> bind(std::string_view optionStr)
+	{
+		std::lock_guard<std::mutex> lock(parseMutex);
+		if( !parse(optionStr) )
+			return std::function<void()>();
+		return [this, args = std::string(optionStr)] {
+			std::lock_guard<std::mutex> lock(parseMutex);
+			tryExecute(args);
+		};
+	}
+	//binary form of the parsed arguments, appended to out, for caching compiled scripts (see CommandParser::compileCached()).
+	//Returns false if the arguments do not parse. unbind() turns it back into what bind() would have returned.
+	virtual bool serialize(std::string_view optionStr, std::string& out)
+	{
+		if( !parse(optionStr) )
+			return false;
+		out.append(optionStr.data(), optionStr.size());
+		return true;
+	}
+	virtual std::function<void()> unbind(std::string_view data)
+	{
+		return bind(data);
+	}
 };
 
 
-//A helper class of a command with no arguments
-template<class Function>
-class CommandOption0 : public CommandOptionBase {
+//A command taking any number of arguments. Arguments are parsed into std::optional's held in place, and the function is called
+//with them through std::apply.
+template<class Function, class...Arguments>
+class CommandOption : public CommandOptionBase {
+	typedef std::tuple<std::optional<Arguments>...> ArgumentTuple;
 	Function func;
-public:
-  CommandOption0(std::string c, std::string d, Function f) : CommandOptionBase(c,d), func(f) {}
-	virtual std::string getArgumentString() {return "";}
-	virtual bool parse(std::string optionStr)
+	ArgumentTuple arguments; //saved by parse() for exec()
+
+	template<std::size_t I>
+	static bool parseArgument(std::string_view& optionStr, ArgumentTuple& args)
 	{
+		typedef typename std::tuple_element<I, std::tuple<Arguments...>>::type ArgumentType;
+		ParsedToken<ArgumentType> token = parseToken<ArgumentType>(nextToken(optionStr));
+		if( !token.isValid() )
+			return false;
+		std::get<I>(args).emplace(token.takeValue());
 		return true;
 	}
-	virtual void exec()
+	template<std::size_t...I>
+	static bool parseArguments([[maybe_unused]] std::string_view optionStr, ArgumentTuple& args, std::index_sequence<I...>)
 	{
-		func();
+		return (parseArgument<I>(optionStr, args) and ...); //left to right, stopping at the first failure
 	}
-};
-
-//A helper class of a command with 1 argument
-template<class Argument0, class Function>
-class CommandOption1 : public CommandOptionBase {
-	Function func;
-	ParsedToken<Argument0> argument0;
-public:
-  CommandOption1(std::string c, std::string d, Function f) : CommandOptionBase(c,d), func(f) {}
-	virtual std::string getArgumentString()
+	std::function<void()> makeInvocation(ArgumentTuple args)
 	{
-		std::stringstream ss;
-		ss << " [" << HumanReadableTypename<Argument0>::get() << "]";
-		return ss.str();
+		return [this, args] {std::apply([this](auto&...values) {func(*values...);}, args);};
 	}
-	virtual bool parse(std::string optionStr)
+
+	//serialized arguments: numbers and enums are stored as their bytes, anything else as its token (length, then text) and parsed
+	//again when loaded, as other trivially copyable types (pointers, std::string_view) may refer to memory of this run
+	template<class T>
+	static constexpr bool storedAsBytes = std::is_arithmetic<T>::value or std::is_enum<T>::value;
+	template<std::size_t I>
+	static bool serializeArgument(std::string_view& optionStr, std::string& out)
 	{
-		std::stringstream str(optionStr);
-#define parseArg(n) std::string arg##n; str >> arg##n; argument##n = TokenParser<Argument##n>::parse(arg##n); if(!argument##n.isValid())return false;
-		parseArg(0);
-#undef parseArg
+		typedef typename std::tuple_element<I, std::tuple<Arguments...>>::type ArgumentType;
+		std::string_view tokenStr = nextToken(optionStr);
+		ParsedToken<ArgumentType> token = parseToken<ArgumentType>(tokenStr);
+		if( !token.isValid() )
+			return false;
+		if constexpr (storedAsBytes<ArgumentType>)
+		{
+			ArgumentType value = token.takeValue();
+			out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+		else
+		{
+			std::uint32_t length = tokenStr.size();
+			out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+			out.append(tokenStr.data(), tokenStr.size());
+		}
 		return true;
 	}
-	virtual void exec()
+	template<std::size_t I>
+	static bool deserializeArgument(std::string_view& data, ArgumentTuple& args)
 	{
-		func(argument0.getValue());
+		typedef typename std::tuple_element<I, std::tuple<Arguments...>>::type ArgumentType;
+		if constexpr (storedAsBytes<ArgumentType>)
+		{
+			if( data.size() < sizeof(ArgumentType) )
+				return false;
+			ArgumentType value;
+			std::memcpy(&value, data.data(), sizeof(value));
+			data.remove_prefix(sizeof(value));
+			std::get<I>(args).emplace(value);
+			return true;
+		}
+		else
+		{
+			std::uint32_t length;
+			if( data.size() < sizeof(length) )
+				return false;
+			std::memcpy(&length, data.data(), sizeof(length));
+			data.remove_prefix(sizeof(length));
+			if( data.size() < length )
+				return false;
+			ParsedToken<ArgumentType> token = parseToken<ArgumentType>(data.substr(0, length));
+			data.remove_prefix(length);
+			if( !token.isValid() )
+				return false;
+			std::get<I>(args).emplace(token.takeValue());
+			return true;
+		}
+	}
+	template<std::size_t...I>
+	static bool serializeArguments([[maybe_unused]] std::string_view optionStr, std::string& out, std::index_sequence<I...>)
+	{
+		return (serializeArgument<I>(optionStr, out) and ...);
+	}
+	template<std::size_t...I>
+	static bool deserializeArguments(std::string_view data, ArgumentTuple& args, std::index_sequence<I...>)
+	{
+		return (deserializeArgument<I>(data, args) and ...) and data.empty();
 	}
-};
-
-//A helper class of a command with 2 arguments
-template<class Argument0, class Argument1, class Function>
-class CommandOption2 : public CommandOptionBase {
-	Function func;
-	ParsedToken<Argument0> argument0;
-	ParsedToken<Argument1> argument1;
 public:
-  CommandOption2(std::string c, std::string d, Function f) : CommandOptionBase(c,d), func(f) {}
+  CommandOption(std::string c, std::string d, Function f) : CommandOptionBase(c,d), func(f) {}
 	virtual std::string getArgumentString()
 	{
 		std::stringstream ss;
-		ss << " [" << HumanReadableTypename<Argument0>::get() << "]"
-		   << " [" << HumanReadableTypename<Argument1>::get() << "]";
+		((ss << " [" << HumanReadableTypename<Arguments>::get() << "]"), ...);
 		return ss.str();
 	}
-	virtual bool parse(std::string optionStr)
+	virtual bool parse(std::string_view optionStr)
 	{
-		std::stringstream str(optionStr);
-#define parseArg(n) std::string arg##n; str >> arg##n; argument##n = TokenParser<Argument##n>::parse(arg##n); if(!argument##n.isValid())return false;
-		parseArg(0);
-		parseArg(1);
-#undef parseArg
-		return true;
+		return parseArguments(optionStr, arguments, std::index_sequence_for<Arguments...>{});
 	}
 	virtual void exec()
 	{
-		func(argument0.getValue(), argument1.getValue());
+		std::apply([this](auto&...values) {func(*values...);}, arguments);
 	}
-};
-
-//A helper class of a command with 3 arguments
-template<class Argument0, class Argument1, class Argument2, class Function>
-class CommandOption3 : public CommandOptionBase {
-	Function func;
-	ParsedToken<Argument0> argument0;
-	ParsedToken<Argument1> argument1;
-	ParsedToken<Argument2> argument2;
-public:
-  CommandOption3(std::string c, std::string d, Function f) : CommandOptionBase(c,d), func(f) {}
-	virtual std::string getArgumentString()
+	virtual bool tryExecute(std::string_view optionStr)
 	{
-		std::stringstream ss;
-		ss << " [" << HumanReadableTypename<Argument0>::get() << "]"
-		   << " [" << HumanReadableTypename<Argument1>::get() << "]"
-		   << " [" << HumanReadableTypename<Argument2>::get() << "]";
-		return ss.str();
+		ArgumentTuple args;
+		if( !parseArguments(optionStr, args, std::index_sequence_for<Arguments...>{}) )
+			return false;
+		std::apply([this](auto&...values) {func(std::move(*values)...);}, args);
+		return true;
 	}
-	virtual bool parse(std::string optionStr)
+	virtual std::function<void()> bind(std::string_view optionStr)
 	{
-		std::stringstream str(optionStr);
-#define parseArg(n) std::string arg##n; str >> arg##n; argument##n = TokenParser<Argument##n>::parse(arg##n); if(!argument##n.isValid())return false;
-		parseArg(0);
-		parseArg(1);
-	  parseArg(2);
-#undef parseArg
-		return true;
+		ArgumentTuple args;
+		if( !parseArguments(optionStr, args, std::index_sequence_for<Arguments...>{}) )
+			return std::function<void()>();
+		return makeInvocation(std::move(args));
 	}
-	virtual void exec()
+	virtual bool serialize(std::string_view optionStr, std::string& out)
 	{
-		func(argument0.getValue(), argument1.getValue(), argument2.getValue());
+		return serializeArguments(optionStr, out, std::index_sequence_for<Arguments...>{});
+	}
+	virtual std::function<void()> unbind(std::string_view data)
+	{
+		ArgumentTuple args;
+		if( !deserializeArguments(data, args, std::index_sequence_for<Arguments...>{}) )
+			return std::function<void()>();
+		return makeInvocation(std::move(args));
 	}
 };
 
+//names of the fixed-arity helper classes this header used to provide
+template<class Function>
+using CommandOption0 = CommandOption<Function>;
+template<class Argument0, class Function>
+using CommandOption1 = CommandOption<Function,Argument0>;
+template<class Argument0, class Argument1, class Function>
+using CommandOption2 = CommandOption<Function,Argument0,Argument1>;
+template<class Argument0, class Argument1, class Argument2, class Function>
+using CommandOption3 = CommandOption<Function,Argument0,Argument1,Argument2>;
+
+//A script compiled by CommandParser::compile(): every line has already been matched to its command and had its arguments parsed,
+//so running it involves no string handling at all. It refers to the commands of the CommandParser that compiled it, which must
+//outlive it.
+class CompiledScript {
+	friend class CommandParser;
+	std::shared_ptr<const std::string> text; //what the arguments were parsed from, when the script owns it (std::string_view arguments point into it)
+	std::vector<std::function<void()>> invocations;
+	std::vector<std::size_t> failedLines; //(0-based) lines that did not match any command
+public:
+	std::size_t size() const {return invocations.size();}
+	const std::vector<std::size_t>& getFailedLines() const {return failedLines;}
+	void run() const
+	{
+		for(const auto& I : invocations)
+			I();
+	}
+};
+
+//what CommandParser::executeStream() did
+struct ExecuteStreamStats {
+	std::size_t executed = 0;
+	std::size_t failed = 0; //non-blank lines that did not match any command
+};
+
+//a candidate returned by CommandParser::complete(); the views stay valid as long as the CommandParser does
+struct CommandCompletion {
+	std::string_view name;
+	std::string_view argumentString; //the expected argument types, same as in the help string: " [bool] [int]"
+};
+
 //The main class - holds all of the commands
 class CommandParser {
 	typedef std::shared_ptr<CommandOptionBase> PointerType;
 	typedef std::vector<PointerType> CommandListType;
 	CommandListType commands;
+	//all commands sharing a name, in the order they were added; keyed by views of the names held by the commands themselves
+	typedef std::vector<CommandOptionBase*> OverloadListType;
+	std::unordered_map<std::string_view, OverloadListType> index;
+	//perfect hash of the command names, built by freeze(); empty if not frozen.
+	//A name first hashes to a bucket, and the seed of that bucket then hashes it to its own slot.
+	struct FrozenSlot {
+		std::string_view name;
+		const OverloadListType* overloads = nullptr;
+	};
+	std::vector<FrozenSlot> frozen;
+	std::vector<std::uint64_t> frozenSeeds;
+	//getArgumentString() of each command, computed once when it is added (a deque, so references stay valid)
+	std::deque<std::string> argumentStrings;
+	//the help string, kept up to date as commands are added: a new command that fits the current column widths is appended,
+	//otherwise the table is rebuilt the next time it is asked for
+	std::string helpString;
+	bool helpStringValid = false;
+	std::size_t maxNameLen = 0;
+	std::size_t maxArgLen = 0;
+	//prefix tree of the command names, for complete(); node 0 is the root
+	struct TrieNode {
+		std::vector<std::pair<char,std::uint32_t>> children; //sorted by character
+		std::vector<std::uint32_t> commandIndexes; //commands whose name ends at this node
+	};
+	std::vector<TrieNode> trie = std::vector<TrieNode>(1);
+
+	static std::uint64_t hashName(std::string_view name, std::uint64_t seed)
+	{
+		std::uint64_t h = 14695981039346656037ull ^ seed; //FNV-1a
+		for(char c : name)
+			h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		return h ^ (h >> 29);
+	}
+	void add(PointerType command)
+	{
+		commands.push_back(command);
+		index[command->getCommandName()].push_back(command.get());
+		frozen.clear();
+		frozenSeeds.clear();
+		argumentStrings.push_back(command->getArgumentString());
+		addToHelpString(commands.size()-1);
+		addToTrie(commands.size()-1);
+	}
+	void appendHelpRow(std::size_t i)
+	{
+		const std::string& name = commands[i]->getCommandName();
+		const std::string& args = argumentStrings[i];
+		helpString += "  ";
+		helpString += name;
+		helpString.append(maxNameLen - name.size(), ' ');
+		helpString += " ";
+		helpString += args;
+		helpString.append(maxArgLen - args.size(), ' ');
+		helpString += " - ";
+		helpString += commands[i]->getDescription();
+		helpString += "\n";
+	}
+	void addToHelpString(std::size_t i)
+	{
+		if( commands[i]->getCommandName().size() > maxNameLen or argumentStrings[i].size() > maxArgLen )
+		{
+			maxNameLen = std::max(maxNameLen, commands[i]->getCommandName().size());
+			maxArgLen = std::max(maxArgLen, argumentStrings[i].size());
+			helpStringValid = false;
+		}
+		else if( helpStringValid )
+			appendHelpRow(i);
+	}
+	void addToTrie(std::size_t i)
+	{
+		std::uint32_t node = 0;
+		for(char c : commands[i]->getCommandName())
+		{
+			auto& children = trie[node].children;
+			auto found = std::lower_bound(children.begin(), children.end(), std::make_pair(c, std::uint32_t(0)),
+				[](const std::pair<char,std::uint32_t>& l, const std::pair<char,std::uint32_t>& r) {return l.first < r.first;});
+			if( found != children.end() and found->first == c )
+				node = found->second;
+			else
+			{
+				std::uint32_t child = trie.size();
+				children.insert(found, std::make_pair(c, child));
+				trie.emplace_back(); //invalidates children
+				node = child;
+			}
+		}
+		trie[node].commandIndexes.push_back(i);
+	}
+	void collectCompletions(std::uint32_t node, std::vector<CommandCompletion>& out, std::size_t maxResults)
+	{
+		for(std::uint32_t i : trie[node].commandIndexes)
+		{
+			if( out.size() >= maxResults ) return;
+			out.push_back(CommandCompletion{commands[i]->getCommandName(), argumentStrings[i]});
+		}
+		for(const auto& C : trie[node].children)
+		{
+			if( out.size() >= maxResults ) return;
+			collectCompletions(C.second, out, maxResults);
+		}
+	}
+	//splits the next line off the front of script
+	static std::string_view nextLine(std::string_view& script)
+	{
+		std::size_t end = script.find('\n');
+		std::string_view line = script.substr(0, end);
+		script.remove_prefix(end == std::string_view::npos ? script.size() : end+1);
+		return line;
+	}
+	static bool isBlank(std::string_view line)
+	{
+		std::string_view rest = line;
+		return nextToken(rest).empty();
+	}
+	//identifies the registered commands, their order and their argument types; part of the key of cached compiled scripts
+	std::uint64_t signature()
+	{
+		std::uint64_t ret = hashName("", commands.size());
+		for(std::size_t i = 0; i < commands.size(); ++i)
+			ret = hashName(argumentStrings[i], hashName(commands[i]->getCommandName(), ret));
+		return ret;
+	}
+	static constexpr char cacheMagic[8] = {'C','M','D','S','C','R','1','\0'};
+	bool loadCache(const std::string& cacheFile, std::uint64_t key, CompiledScript& script)
+	{
+		std::ifstream in(cacheFile, std::ios::binary);
+		auto read = [&](auto& value) {return bool(in.read(reinterpret_cast<char*>(&value), sizeof(value)));};
+		char magic[sizeof(cacheMagic)];
+		std::uint64_t storedKey, count, failed;
+		if( !in.read(magic, sizeof(magic)) or !std::equal(magic, magic+sizeof(magic), cacheMagic) )
+			return false;
+		if( !read(storedKey) or storedKey != key or !read(count) or !read(failed) )
+			return false;
+		for(std::uint64_t i = 0; i < failed; ++i)
+		{
+			std::uint64_t line;
+			if( !read(line) ) return false;
+			script.failedLines.push_back(line);
+		}
+		//all the records are read before any is unbound, as arguments may point into the data the script keeps
+		auto data = std::make_shared<std::string>();
+		std::vector<std::pair<std::uint32_t,std::size_t>> records; //command, end of its data
+		for(std::uint64_t i = 0; i < count; ++i)
+		{
+			std::uint32_t command, length;
+			if( !read(command) or !read(length) or command >= commands.size() )
+				return false;
+			const std::size_t begin = data->size();
+			data->resize(begin + length);
+			if( length and !in.read(&(*data)[begin], length) )
+				return false;
+			records.emplace_back(command, data->size());
+		}
+		std::size_t begin = 0;
+		for(const auto& R : records)
+		{
+			std::function<void()> invocation = commands[R.first]->unbind(std::string_view(*data).substr(begin, R.second-begin));
+			if( !invocation )
+				return false;
+			script.invocations.push_back(std::move(invocation));
+			begin = R.second;
+		}
+		script.text = std::move(data);
+		return true;
+	}
+	//binds every line of a batch on the pool, then runs the bound commands in order; consecutive commutative commands run on the pool
+	void executeBatch(const std::vector<std::string_view>& lines, ThreadPool& pool, ExecuteStreamStats& stats)
+	{
+		struct Bound {
+			std::function<void()> invocation;
+			bool commutative = false;
+			bool blank = false;
+		};
+		std::vector<Bound> bound(lines.size());
+		pool.parallelFor(0, lines.size(), 64, [&](std::size_t i) {
+			if( isBlank(lines[i]) )
+			{
+				bound[i].blank = true;
+				return;
+			}
+			std::string_view remaining = lines[i];
+			const OverloadListType* overloads = findOverloads(nextToken(remaining));
+			if( overloads )
+				for(CommandOptionBase* C : *overloads)
+					if( (bound[i].invocation = C->bind(remaining)) )
+					{
+						bound[i].commutative = C->isCommutative();
+						break;
+					}
+		});
+		for(std::size_t i = 0; i < bound.size(); )
+		{
+			if( !bound[i].invocation )
+			{
+				stats.failed += !bound[i].blank;
+				++i;
+				continue;
+			}
+			std::size_t end = i+1;
+			if( bound[i].commutative )
+				while( end < bound.size() and bound[end].commutative )
+					++end;
+			if( end - i > 1 )
+				pool.parallelFor(i, end, 16, [&](std::size_t c) {bound[c].invocation();});
+			else
+				bound[i].invocation();
+			stats.executed += end - i;
+			i = end;
+		}
+	}
+	const OverloadListType* findOverloads(std::string_view name)
+	{
+		if( !frozen.empty() )
+		{
+			std::uint64_t seed = frozenSeeds[hashName(name, 0) & (frozenSeeds.size()-1)];
+			const FrozenSlot& slot = frozen[hashName(name, seed) & (frozen.size()-1)];
+			return slot.name == name ? slot.overloads : nullptr;
+		}
+		auto found = index.find(name);
+		return found == index.end() ? nullptr : &found->second;
+	}
 public:
   CommandParser() {}
-	template<class Function> void addCommand(std::string command, std::string desc, Function f)
-  {
-	  commands.push_back(PointerType(new CommandOption0<Function>(command, desc, f)));
-  }
-  template<class Argument0, class Function> void addCommand(std::string command, std::string desc, Function f)
-  {
-	  commands.push_back(PointerType(new CommandOption1<Argument0,Function>(command, desc, f)));
-  }
-	template<class Argument0, class Argument1, class Function> void addCommand(std::string command, std::string desc, Function f)
-  {
-	  commands.push_back(PointerType(new CommandOption2<Argument0,Argument1,Function>(command, desc, f)));
-  }
-	template<class Argument0, class Argument1, class Argument2, class Function> void addCommand(std::string command, std::string desc, Function f)
+	//the argument types are given explicitly, the function type is deduced: addCommand<bool,int>("name", "description", func)
+	template<class...Arguments, class Function> void addCommand(std::string command, std::string desc, Function f)
   {
-	  commands.push_back(PointerType(new CommandOption3<Argument0,Argument1,Argument2,Function>(command, desc, f)));
+	  add(PointerType(new CommandOption<Function,Arguments...>(command, desc, f)));
   }
-  //if more arguments are needed, see above for format of how to create the helper class and functions
 
   //get the help string of all the currently added commands
-	std::string getHelpString()
+	const std::string& getHelpString()
 	{
-		std::stringstream ss;
-		ss << "Valid options:\n";
-		unsigned maxNameLen = 0;
-		unsigned maxArgLen  = 0;
-		unsigned maxDescLen = 0;
-		for(CommandListType::iterator CI = commands.begin(); CI != commands.end(); ++CI)
+		if( !helpStringValid )
 		{
-			if( maxNameLen < (*CI)->getCommandName().length() )
-				maxNameLen = (*CI)->getCommandName().length();
-			if( maxArgLen < (*CI)->getArgumentString().length() )
-				maxArgLen = (*CI)->getArgumentString().length();
-			if( maxDescLen < (*CI)->getDescription().length() )
-				maxDescLen = (*CI)->getDescription().length();
+			helpString = "Valid options:\n";
+			for(std::size_t i = 0; i < commands.size(); ++i)
+				appendHelpRow(i);
+			helpStringValid = true;
 		}
-		for(CommandListType::iterator CI = commands.begin(); CI != commands.end(); ++CI)
+		return helpString;
+	}
+	//the commands whose name starts with prefix (in alphabetical order, overloads in the order they were added), for tab completion
+	std::vector<CommandCompletion> complete(std::string_view prefix, std::size_t maxResults = std::size_t(-1))
+	{
+		std::vector<CommandCompletion> ret;
+		std::uint32_t node = 0;
+		for(char c : prefix)
 		{
-			ss << "  "
-			   << std::left << std::setw(maxNameLen) << (*CI)->getCommandName()
-				 << " "
-			   << std::left << std::setw(maxArgLen) << (*CI)->getArgumentString()
-				 << " - "
-				 << std::left << (*CI)->getDescription() << "\n";
+			const auto& children = trie[node].children;
+			auto found = std::lower_bound(children.begin(), children.end(), std::make_pair(c, std::uint32_t(0)),
+				[](const std::pair<char,std::uint32_t>& l, const std::pair<char,std::uint32_t>& r) {return l.first < r.first;});
+			if( found == children.end() or found->first != c )
+				return ret;
+			node = found->second;
 		}
-		return ss.str();
+		collectCompletions(node, ret, maxResults);
+		return ret;
 	}
-	//find the first command that matches in name, as well as has arguments that can be parsed from the remaining string
-  bool execute(std::string line)
-  {
-		std::stringstream ss(line);
-		std::string commandName;
-		ss >> commandName;
-		std::string remaining;
-		getline(ss, remaining);
-		for(CommandListType::iterator CI = commands.begin(); CI != commands.end(); ++CI)
+	//build a perfect hash of the current command names, so that lookups hash once and compare a single name.
+	//The set of commands is considered frozen until the next addCommand().
+	void freeze()
+	{
+		frozen.clear();
+		frozenSeeds.clear();
+		if( index.empty() ) return;
+		std::size_t slots = 1, buckets = 1;
+		while( slots < 2*index.size() )
+			slots *= 2;
+		while( buckets*4 < index.size() )
+			buckets *= 2;
+		typedef decltype(index)::value_type IndexEntry;
+		std::vector<std::vector<const IndexEntry*>> bucketEntries(buckets);
+		for(const IndexEntry& I : index)
+			bucketEntries[hashName(I.first, 0) & (buckets-1)].push_back(&I);
+		//place the fullest buckets first, while the table is still mostly empty
+		std::vector<std::size_t> order(buckets);
+		for(std::size_t b = 0; b < buckets; ++b)
+			order[b] = b;
+		std::sort(order.begin(), order.end(), [&](std::size_t l, std::size_t r) {return bucketEntries[l].size() > bucketEntries[r].size();});
+
+		std::vector<FrozenSlot> table(slots);
+		std::vector<std::uint64_t> seeds(buckets, 0);
+		std::vector<std::size_t> positions;
+		for(std::size_t b : order)
 		{
-			if( (*CI)->getCommandName() == commandName )
+			if( bucketEntries[b].empty() ) break;
+			//try seeds until every name of the bucket lands in a distinct free slot
+			for(std::uint64_t seed = 1; ; ++seed)
 			{
-				if( (*CI)->parse(remaining) )
+				positions.clear();
+				for(const IndexEntry* E : bucketEntries[b])
 				{
-					(*CI)->exec();
-					return true;
+					std::size_t pos = hashName(E->first, seed) & (slots-1);
+					if( table[pos].overloads or std::find(positions.begin(), positions.end(), pos) != positions.end() )
+						break;
+					positions.push_back(pos);
+				}
+				if( positions.size() == bucketEntries[b].size() )
+				{
+					for(std::size_t i = 0; i < positions.size(); ++i)
+					{
+						table[positions[i]].name = bucketEntries[b][i]->first;
+						table[positions[i]].overloads = &bucketEntries[b][i]->second;
+					}
+					seeds[b] = seed;
+					break;
 				}
 			}
 		}
+		frozen.swap(table);
+		frozenSeeds.swap(seeds);
+	}
+	//compiles a script of commands, one per line; lines that do not match any command are skipped (and listed in getFailedLines()),
+	//same as execute() would for them. Arguments parsed as views (std::string_view) point into script, which must outlive the
+	//compiled script.
+	CompiledScript compile(std::string_view script)
+	{
+		CompiledScript ret;
+		for(std::size_t lineNumber = 0; !script.empty(); ++lineNumber)
+		{
+			std::string_view line = nextLine(script);
+			if( isBlank(line) )
+				continue;
+			std::string_view remaining = line;
+			const OverloadListType* overloads = findOverloads(nextToken(remaining));
+			std::function<void()> invocation;
+			if( overloads )
+				for(CommandOptionBase* C : *overloads)
+					if( (invocation = C->bind(remaining)) )
+						break;
+			if( invocation )
+				ret.invocations.push_back(std::move(invocation));
+			else
+				ret.failedLines.push_back(lineNumber);
+		}
+		return ret;
+	}
+	//the compiled script keeps the text read from script
+	CompiledScript compile(std::istream& script)
+	{
+		std::stringstream ss;
+		ss << script.rdbuf();
+		auto text = std::make_shared<const std::string>(ss.str());
+		CompiledScript ret = compile(std::string_view(*text));
+		ret.text = std::move(text);
+		return ret;
+	}
+	//same as compile(), but the parsed script is kept in cacheFile: if that holds the same script, compiled for the same set of
+	//commands, it is loaded from there instead of being tokenized and matched again. The cache is only meant to be read back by
+	//the same build of the same program.
+	CompiledScript compileCached(std::string_view script, const std::string& cacheFile)
+	{
+		std::uint64_t key = hashName(script, signature());
+		CompiledScript ret;
+		if( loadCache(cacheFile, key, ret) )
+			return ret;
+
+		ret = CompiledScript();
+		std::unordered_map<CommandOptionBase*, std::uint32_t> commandIndex;
+		for(std::uint32_t i = 0; i < commands.size(); ++i)
+			commandIndex[commands[i].get()] = i;
+		std::ofstream out(cacheFile, std::ios::binary | std::ios::trunc);
+		std::string records, data;
+		std::vector<std::pair<CommandOptionBase*,std::size_t>> bound; //command, position of its data in records
+		std::uint64_t count = 0;
+		for(std::size_t lineNumber = 0; !script.empty(); ++lineNumber)
+		{
+			std::string_view line = nextLine(script);
+			if( isBlank(line) )
+				continue;
+			//the first overload whose arguments serialize, as compile() takes the first that binds
+			std::string_view remaining = line;
+			const OverloadListType* overloads = findOverloads(nextToken(remaining));
+			CommandOptionBase* command = nullptr;
+			if( overloads )
+				for(CommandOptionBase* C : *overloads)
+				{
+					data.clear();
+					if( C->serialize(remaining, data) )
+					{
+						command = C;
+						break;
+					}
+				}
+			if( !command )
+			{
+				ret.failedLines.push_back(lineNumber);
+				continue;
+			}
+			std::uint32_t index = commandIndex[command], length = data.size();
+			records.append(reinterpret_cast<const char*>(&index), sizeof(index));
+			records.append(reinterpret_cast<const char*>(&length), sizeof(length));
+			bound.emplace_back(command, records.size());
+			records += data;
+			++count;
+		}
+		//unbound from the records the script keeps, as arguments may point into them
+		auto text = std::make_shared<const std::string>(std::move(records));
+		for(std::size_t i = 0; i < bound.size(); ++i)
+		{
+			const std::size_t end = i+1 < bound.size() ? bound[i+1].second - 2*sizeof(std::uint32_t) : text->size();
+			ret.invocations.push_back(bound[i].first->unbind(std::string_view(*text).substr(bound[i].second, end - bound[i].second)));
+		}
+		ret.text = text;
+		std::uint64_t failed = ret.failedLines.size();
+		out.write(cacheMagic, sizeof(cacheMagic));
+		out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+		out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		out.write(reinterpret_cast<const char*>(&failed), sizeof(failed));
+		for(std::uint64_t line : ret.failedLines)
+			out.write(reinterpret_cast<const char*>(&line), sizeof(line));
+		out.write(text->data(), text->size());
+		return ret;
+	}
+	//marks every command with this name as commutative; returns false if there is none
+	bool markCommutative(std::string_view name, bool commutative = true)
+	{
+		const OverloadListType* overloads = findOverloads(name);
+		if( !overloads )
+			return false;
+		for(CommandOptionBase* C : *overloads)
+			C->setCommutative(commutative);
+		return true;
+	}
+	//Executes a stream of commands, one per line, the same as calling execute() on each line, but using a thread pool.
+	//Lines are handled in batches: the lines of a batch are tokenized and have their arguments parsed in parallel (so
+	//TokenParser's and overrides of bind() must be thread safe), then the commands run in order on the calling thread. Runs of consecutive
+	//commutative commands (see markCommutative()) are instead spread across the pool, and must be thread safe themselves.
+	ExecuteStreamStats executeStream(std::string_view commandText, ThreadPool& pool, std::size_t batchSize = 4096)
+	{
+		ExecuteStreamStats stats;
+		std::vector<std::string_view> lines;
+		while( !commandText.empty() )
+		{
+			lines.clear();
+			while( !commandText.empty() and lines.size() < batchSize )
+				lines.push_back(nextLine(commandText));
+			executeBatch(lines, pool, stats);
+		}
+		return stats;
+	}
+	ExecuteStreamStats executeStream(std::istream& in, ThreadPool& pool, std::size_t batchSize = 4096)
+	{
+		ExecuteStreamStats stats;
+		std::vector<std::string> text;
+		std::vector<std::string_view> lines;
+		while( in )
+		{
+			text.clear();
+			std::string line;
+			while( text.size() < batchSize and std::getline(in, line) )
+				text.push_back(std::move(line));
+			lines.assign(text.begin(), text.end());
+			executeBatch(lines, pool, stats);
+		}
+		return stats;
+	}
+	//find the first command that matches in name, as well as has arguments that can be parsed from the remaining string
+  bool execute(std::string_view line)
+  {
+		std::string_view remaining = line;
+		std::string_view commandName = nextToken(remaining);
+		const OverloadListType* overloads = findOverloads(commandName);
+		if( !overloads )
+			return false;
+		for(CommandOptionBase* C : *overloads)
+			if( C->tryExecute(remaining) )
+				return true;
 		return false;
 	}
 };
@@ -0,0 +1,194 @@
+/**************************************
+
+Optional built-in TokenParser<> specializations for CommandParser.hpp.
+
+CommandParser.hpp deliberately has no built-in TokenParsers, as applications may want different rules even for
+built-in types. Applications that are happy with the rules below can include this header instead of writing their own:
+
+  integer types (except char)  decimal, or hex/octal/binary with a 0x/0o/0b prefix, with an optional sign: "42", "-0x2a", "0b101010"
+  char                         a single character
+  float, double, long double   anything std::from_chars accepts in general format: "1.5", "-2e10", "inf"
+  bool                         "1", "on", "true", "yes" or "0", "off", "false", "no", in any case
+  std::string                  the token itself
+  std::string_view             the token itself, as a view into the text being executed: it is only valid during the call,
+                               or for compiled scripts as long as the text they were compiled from (CommandParser::compile()
+                               of a std::string_view; compile() of a stream and compileCached() keep their own copy)
+
+All parsers take the token as a std::string_view and parse it in place with std::from_chars, without streams or copies;
+a token is only accepted if all of it is used.
+
+***************************************/
+
+#ifndef _COMMAND_PARSER_TOKEN_PARSERS_HPP__
+#define _COMMAND_PARSER_TOKEN_PARSERS_HPP__
+
+#include "CommandParser.hpp"
+
+#include <charconv>
+#include <limits>
+#include <type_traits>
+
+namespace CommandParserTokenParsers {
+
+template<class T>
+ParsedToken<T> parseInteger(std::string_view token)
+{
+	typedef typename std::make_unsigned<T>::type Unsigned;
+	bool negative = false;
+	if( !token.empty() and (token.front() == '-' or token.front() == '+') )
+	{
+		negative = token.front() == '-';
+		token.remove_prefix(1);
+	}
+	int base = 10;
+	if( token.size() > 2 and token[0] == '0' )
+	{
+		switch( token[1] )
+		{
+			case 'x': case 'X': base = 16; break;
+			case 'o': case 'O': base = 8; break;
+			case 'b': case 'B': base = 2; break;
+		}
+		if( base != 10 )
+			token.remove_prefix(2);
+	}
+	//from_chars would accept a second sign for signed types, so the magnitude is always parsed as unsigned
+	Unsigned magnitude;
+	if( token.empty() or token.front() == '-' or token.front() == '+' )
+		return ParsedToken<T>();
+	std::from_chars_result result = std::from_chars(token.data(), token.data()+token.size(), magnitude, base);
+	if( result.ec != std::errc() or result.ptr != token.data()+token.size() )
+		return ParsedToken<T>();
+	const Unsigned maxMagnitude = std::numeric_limits<T>::max();
+	if( !negative )
+	{
+		if( magnitude > maxMagnitude )
+			return ParsedToken<T>();
+		return ParsedToken<T>(static_cast<T>(magnitude));
+	}
+	if( magnitude == 0 )
+		return ParsedToken<T>(T(0));
+	if( !std::is_signed<T>::value or magnitude > maxMagnitude + Unsigned(1) )
+		return ParsedToken<T>();
+	return ParsedToken<T>(static_cast<T>(Unsigned(0) - magnitude)); //two's complement negation, also right for the minimum value
+}
+
+template<class T>
+ParsedToken<T> parseFloating(std::string_view token)
+{
+	if( !token.empty() and token.front() == '+' ) //from_chars only accepts '-'
+		token.remove_prefix(1);
+	T value;
+	std::from_chars_result result = std::from_chars(token.data(), token.data()+token.size(), value);
+	if( token.empty() or result.ec != std::errc() or result.ptr != token.data()+token.size() )
+		return ParsedToken<T>();
+	return ParsedToken<T>(value);
+}
+
+inline bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs)
+{
+	if( lhs.size() != rhs.size() )
+		return false;
+	for(std::size_t i = 0; i < lhs.size(); ++i)
+		if( (lhs[i] | 0x20) != rhs[i] ) //rhs is lower case letters or digits
+			return false;
+	return true;
+}
+
+} /* namespace CommandParserTokenParsers */
+
+#define COMMAND_PARSER_INTEGER_TOKEN_PARSER(Type, Name) \
+template<> class TokenParser<Type> { \
+public: \
+	static ParsedToken<Type> parse(std::string_view token) {return CommandParserTokenParsers::parseInteger<Type>(token);} \
+}; \
+template<> class HumanReadableTypename<Type> { \
+public: \
+	static std::string get() {return Name;} \
+};
+
+#define COMMAND_PARSER_FLOATING_TOKEN_PARSER(Type, Name) \
+template<> class TokenParser<Type> { \
+public: \
+	static ParsedToken<Type> parse(std::string_view token) {return CommandParserTokenParsers::parseFloating<Type>(token);} \
+}; \
+template<> class HumanReadableTypename<Type> { \
+public: \
+	static std::string get() {return Name;} \
+};
+
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(signed char, "signed char")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(unsigned char, "unsigned char")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(short, "short")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(unsigned short, "unsigned short")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(unsigned int, "unsigned")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(long, "long")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(unsigned long, "unsigned long")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(long long, "long long")
+COMMAND_PARSER_INTEGER_TOKEN_PARSER(unsigned long long, "unsigned long long")
+COMMAND_PARSER_FLOATING_TOKEN_PARSER(float, "float")
+COMMAND_PARSER_FLOATING_TOKEN_PARSER(double, "double")
+COMMAND_PARSER_FLOATING_TOKEN_PARSER(long double, "long double")
+
+#undef COMMAND_PARSER_INTEGER_TOKEN_PARSER
+#undef COMMAND_PARSER_FLOATING_TOKEN_PARSER
+
+//HumanReadableTypename<int> is already provided by CommandParser.hpp
+template<> class TokenParser<int> {
+public:
+	static ParsedToken<int> parse(std::string_view token) {return CommandParserTokenParsers::parseInteger<int>(token);}
+};
+
+template<> class TokenParser<char> {
+public:
+	static ParsedToken<char> parse(std::string_view token)
+	{
+		if( token.size() != 1 )
+			return ParsedToken<char>();
+		return ParsedToken<char>(token.front());
+	}
+};
+template<> class HumanReadableTypename<char> {
+public:
+	static std::string get() {return "char";}
+};
+
+template<> class TokenParser<bool> {
+public:
+	static ParsedToken<bool> parse(std::string_view token)
+	{
+		using CommandParserTokenParsers::equalsIgnoreCase;
+		if( token == "1" or equalsIgnoreCase(token, "on") or equalsIgnoreCase(token, "true") or equalsIgnoreCase(token, "yes") )
+			return ParsedToken<bool>(true);
+		if( token == "0" or equalsIgnoreCase(token, "off") or equalsIgnoreCase(token, "false") or equalsIgnoreCase(token, "no") )
+			return ParsedToken<bool>(false);
+		return ParsedToken<bool>();
+	}
+};
+
+//an empty token means the argument is missing
+template<> class TokenParser<std::string> {
+public:
+	static ParsedToken<std::string> parse(std::string_view token)
+	{
+		if( token.empty() )
+			return ParsedToken<std::string>();
+		return ParsedToken<std::string>(std::string(token));
+	}
+};
+
+template<> class TokenParser<std::string_view> {
+public:
+	static ParsedToken<std::string_view> parse(std::string_view token)
+	{
+		if( token.empty() )
+			return ParsedToken<std::string_view>();
+		return ParsedToken<std::string_view>(token);
+	}
+};
+template<> class HumanReadableTypename<std::string_view> {
+public:
+	static std::string get() {return "string";}
+};
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef MULTI_ARRAY_H__
+#define MULTI_ARRAY_H__
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+/*
+   Multidimensional containers:
+     multi_array_t<T,I,Rest...>     nested std::arrays of compile-time size
+     multi_vector_t<T,Dim>          nested std::vectors, each row a separate allocation
+     multi_flat_array_t<T,Dim>      one allocation, row-major with strides
+     multi_flat_view_t<T,Dim>       a window into a multi_flat_array_t (or any strided memory), without copies
+
+	multi_flat_array_t<float,3,32> volume(64, 480, 640); //rows start on 32 byte boundaries, for SIMD loads
+	volume.at(2, 100, 200) = 1;
+	multi_flat_view_t<float,2> plane = volume.slice(2); //the 480x640 plane at index 2 of the first dimension
+	multi_flat_view_t<float,2> box = plane.sub({100, 200}, {110, 220}); //rows [100,110), columns [200,220)
+	box.at(0, 0) = 2; //volume.at(2, 100, 200)
+
+   All of them take the indexes of at() outermost first, and check each of them. operator() takes the
+     same indexes without checking them (only asserting, in debug builds), for inner loops whose bounds
+	 have been checked once outside of them:
+
+	multi_flat_view_t<float,2> window = plane.sub({r, c}, {r+3, c+3}); //throws if the window does not fit
+	for(int i = 0; i < 3; ++i)
+		for(int j = 0; j < 3; ++j)
+			sum += window(i, j) * kernel(i, j);
+*/
+
+namespace details {
+
+template<class T, int I, int...Rest>
+struct multi_array_impl {
+	using type = std::array<typename multi_array_impl<T,Rest...>::type, I>;
+};
+template<class T, int I>
+struct multi_array_impl<T,I> {
+	using type = std::array<T, I>;
+};
+
+template<class T, std::size_t Dim>
+struct multi_vector_impl {
+	static_assert( Dim > 1 );
+	using type = std::vector<typename multi_vector_impl<T,Dim-1>::type>;
+};
+template<class T>
+struct multi_vector_impl<T,1> {
+	using type = std::vector<T>;
+};
+
+template<class T, std::size_t Alignment>
+struct aligned_allocator {
+	typedef T value_type;
+	template<class U> struct rebind {typedef aligned_allocator<U,Alignment> other;};
+	aligned_allocator() = default;
+	template<class U>
+	aligned_allocator(const aligned_allocator<U,Alignment>&) {}
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+	}
+	void deallocate(T* p, std::size_t)
+	{
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+	template<class U>
+	bool operator == (const aligned_allocator<U,Alignment>&) const {return true;}
+	template<class U>
+	bool operator != (const aligned_allocator<U,Alignment>&) const {return false;}
+};
+
+} /* namespace details */
+
+template<class T,int I, int...Rest>
+class multi_array_t : public details::multi_array_impl<T, I, Rest...>::type {
+	template<class A>
+	inline constexpr decltype(auto) atHelper(A& a, int FirstIndex)
+	{
+		return a.at(FirstIndex);
+	}
+	template<class A, class...RestIndexTy>
+	inline constexpr decltype(auto) atHelper(A& a, int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return atHelper(a.at(FirstIndex), RestIndex...);
+	}
+	template<class A, class...RestIndexTy>
+	inline constexpr decltype(auto) uncheckedHelper(A& a, int FirstIndex, RestIndexTy...RestIndex)
+	{
+		assert( FirstIndex >= 0 and std::size_t(FirstIndex) < a.size() );
+		if constexpr (sizeof...(RestIndex))
+			return uncheckedHelper(a[FirstIndex], RestIndex...);
+		else
+			return a[FirstIndex];
+	}
+public:
+	typedef typename details::multi_array_impl<T, I, Rest...>::type type;
+	using type::type;
+	template<class...RestIndexTy>
+	inline constexpr decltype(auto) at(int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return atHelper(*static_cast<type*>(this),FirstIndex,RestIndex...);
+	}
+	template<class...RestIndexTy>
+	inline constexpr decltype(auto) operator () (int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return uncheckedHelper(*static_cast<type*>(this),FirstIndex,RestIndex...);
+	}
+	void fill(T value)
+	{
+		if constexpr (sizeof...(Rest))
+		{
+			multi_array_t<T,Rest...> partial;
+			partial.fill(value);
+			type::fill(partial);
+		}
+		else
+			type::fill(value);
+	}
+};
+
+template<class T, std::size_t Dim>
+class multi_vector_t : public details::multi_vector_impl<T, Dim>::type {
+	template<class A>
+	inline constexpr decltype(auto) atHelper(A& a, int FirstIndex)
+	{
+		return a.at(FirstIndex);
+	}
+	template<class A, class...RestIndexTy>
+	inline constexpr decltype(auto) atHelper(A& a, int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return atHelper(a.at(FirstIndex), RestIndex...);
+	}
+	template<class A, class...RestIndexTy>
+	inline constexpr decltype(auto) uncheckedHelper(A& a, int FirstIndex, RestIndexTy...RestIndex)
+	{
+		assert( FirstIndex >= 0 and std::size_t(FirstIndex) < a.size() );
+		if constexpr (sizeof...(RestIndex))
+			return uncheckedHelper(a[FirstIndex], RestIndex...);
+		else
+			return a[FirstIndex];
+	}
+	template<class A, class...RestSizeTy>
+	void resizeHelper(A& a, int firstSize, RestSizeTy...restSize)
+	{
+		a.resize(firstSize);
+		if constexpr (sizeof...(restSize))
+			for(auto& V : a)
+				resizeHelper(V, restSize...);
+	}
+public:
+	typedef typename details::multi_vector_impl<T, Dim>::type type;
+	using type::type;
+	using type::resize;
+	multi_vector_t(const type& v) : type(v) {}
+	template<class...RestIndexTy>
+	inline constexpr decltype(auto) at(int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return atHelper(*static_cast<type*>(this),FirstIndex,RestIndex...);
+	}
+	template<class...RestIndexTy>
+	inline constexpr decltype(auto) operator () (int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return uncheckedHelper(*static_cast<type*>(this),FirstIndex,RestIndex...);
+	}
+	template<class...RestSizeTy, std::size_t D = Dim>
+	typename std::enable_if<(D > 1)>::type resize(int firstSize, RestSizeTy...restSize)
+	{
+		resizeHelper(*static_cast<type*>(this), firstSize, restSize...);
+	}
+	multi_vector_t<T,Dim-1>& child(int i)
+	{
+		typename multi_vector_t<T,Dim-1>::type& ret = type::at(i);
+		return *static_cast<multi_vector_t<T,Dim-1>*>(&ret);
+	}
+};
+
+template<class T, std::size_t Dim>
+class multi_flat_view_t {
+	T* base = nullptr;
+	std::array<int,Dim> extents{}, strides{};
+
+	template<std::size_t D, class...RestIndexTy>
+	std::ptrdiff_t offsetChecked(int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		if( FirstIndex < 0 or FirstIndex >= extents[D] )
+			throw std::out_of_range("multi_flat_view_t::at");
+		if constexpr (sizeof...(RestIndex))
+			return std::ptrdiff_t(FirstIndex)*strides[D] + offsetChecked<D+1>(RestIndex...);
+		else
+			return std::ptrdiff_t(FirstIndex)*strides[D];
+	}
+	template<std::size_t D, class...RestIndexTy>
+	std::ptrdiff_t offset(int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		assert( FirstIndex >= 0 and FirstIndex < extents[D] );
+		if constexpr (sizeof...(RestIndex))
+			return std::ptrdiff_t(FirstIndex)*strides[D] + offset<D+1>(RestIndex...);
+		else
+			return std::ptrdiff_t(FirstIndex)*strides[D];
+	}
+public:
+	multi_flat_view_t() = default;
+	multi_flat_view_t(T* base, const std::array<int,Dim>& extents, const std::array<int,Dim>& strides)
+		: base(base), extents(extents), strides(strides) {}
+	//views of T convert to views of const T
+	template<class U, class = std::enable_if_t<std::is_same<const U,T>::value and !std::is_same<U,T>::value>>
+	multi_flat_view_t(const multi_flat_view_t<U,Dim>& other) : base(other.data()), extents(other.getExtents()), strides(other.getStrides()) {}
+
+	template<class...RestIndexTy>
+	T& at(int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		static_assert( sizeof...(RestIndex)+1 == Dim );
+		return base[offsetChecked<0>(FirstIndex, RestIndex...)];
+	}
+	template<class...RestIndexTy>
+	T& operator () (int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		static_assert( sizeof...(RestIndex)+1 == Dim );
+		return base[offset<0>(FirstIndex, RestIndex...)];
+	}
+	//the view of dimension Dim-1 at index i of the first dimension
+	template<std::size_t D = Dim>
+	typename std::enable_if<(D > 1), multi_flat_view_t<T,Dim-1>>::type slice(int i) const
+	{
+		if( i < 0 or i >= extents[0] )
+			throw std::out_of_range("multi_flat_view_t::slice");
+		return sliceUnchecked(i);
+	}
+	template<std::size_t D = Dim>
+	typename std::enable_if<(D > 1), multi_flat_view_t<T,Dim-1>>::type sliceUnchecked(int i) const
+	{
+		assert( i >= 0 and i < extents[0] );
+		std::array<int,Dim-1> e, s;
+		for(std::size_t d = 1; d < Dim; ++d)
+		{
+			e[d-1] = extents[d];
+			s[d-1] = strides[d];
+		}
+		return multi_flat_view_t<T,Dim-1>(base + std::ptrdiff_t(i)*strides[0], e, s);
+	}
+	//the box [begin,end) in every dimension
+	multi_flat_view_t sub(const std::array<int,Dim>& begin, const std::array<int,Dim>& end) const
+	{
+		std::ptrdiff_t offset = 0;
+		std::array<int,Dim> e;
+		for(std::size_t d = 0; d < Dim; ++d)
+		{
+			if( begin[d] < 0 or begin[d] > end[d] or end[d] > extents[d] )
+				throw std::out_of_range("multi_flat_view_t::sub");
+			offset += std::ptrdiff_t(begin[d])*strides[d];
+			e[d] = end[d] - begin[d];
+		}
+		return multi_flat_view_t(base + offset, e, strides);
+	}
+	int size(std::size_t d = 0) const {return extents.at(d);}
+	const std::array<int,Dim>& getExtents() const {return extents;}
+	const std::array<int,Dim>& getStrides() const {return strides;}
+	T* data() const {return base;}
+};
+
+//Alignment applies to the start of every innermost row: rows are padded to a multiple of it (of
+//  lcm(Alignment, sizeof(T)) bytes when sizeof(T) does not divide it), so a row can be loaded with
+//  aligned SIMD instructions. The default adds no padding.
+//Strides are ints: resize() throws std::length_error if one does not fit.
+//resize() does not keep the elements.
+template<class T, std::size_t Dim, std::size_t Alignment = alignof(T)>
+class multi_flat_array_t {
+	static_assert( Dim > 0 );
+	static_assert( Alignment >= alignof(T) and Alignment % alignof(T) == 0 );
+	std::vector<T, details::aligned_allocator<T,Alignment>> storage;
+	std::array<int,Dim> extents{}, strides{};
+
+	template<std::size_t D, class...RestIndexTy>
+	std::size_t offsetChecked(int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		if( FirstIndex < 0 or FirstIndex >= extents[D] )
+			throw std::out_of_range("multi_flat_array_t::at");
+		if constexpr (sizeof...(RestIndex))
+			return std::size_t(FirstIndex)*strides[D] + offsetChecked<D+1>(RestIndex...);
+		else
+			return std::size_t(FirstIndex)*strides[D];
+	}
+public:
+	typedef T value_type;
+	multi_flat_array_t() = default;
+	template<class...RestSizeTy>
+	explicit multi_flat_array_t(int firstSize, RestSizeTy...restSize)
+	{
+		resize(firstSize, restSize...);
+	}
+	template<class...RestSizeTy>
+	void resize(int firstSize, RestSizeTy...restSize)
+	{
+		static_assert( sizeof...(restSize)+1 == Dim );
+		extents = {firstSize, int(restSize)...};
+		constexpr std::size_t perAlignment = std::lcm(Alignment, sizeof(T)) / sizeof(T);
+		std::size_t stride = (std::size_t(extents[Dim-1]) + perAlignment-1) / perAlignment * perAlignment;
+		strides[Dim-1] = 1;
+		for(std::size_t d = Dim-1; d-- > 0;)
+		{
+			if( stride > std::size_t(std::numeric_limits<int>::max()) )
+				throw std::length_error("multi_flat_array_t::resize: stride does not fit in an int");
+			strides[d] = stride;
+			stride *= extents[d];
+		}
+		storage.assign(Dim > 1 ? stride : extents[0], T());
+	}
+	template<class...RestIndexTy>
+	T& at(int FirstIndex, RestIndexTy...RestIndex)
+	{
+		static_assert( sizeof...(RestIndex)+1 == Dim );
+		return storage[offsetChecked<0>(FirstIndex, RestIndex...)];
+	}
+	template<class...RestIndexTy>
+	const T& at(int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		static_assert( sizeof...(RestIndex)+1 == Dim );
+		return storage[offsetChecked<0>(FirstIndex, RestIndex...)];
+	}
+	template<class...RestIndexTy>
+	T& operator () (int FirstIndex, RestIndexTy...RestIndex)
+	{
+		return view()(FirstIndex, RestIndex...);
+	}
+	template<class...RestIndexTy>
+	const T& operator () (int FirstIndex, RestIndexTy...RestIndex) const
+	{
+		return view()(FirstIndex, RestIndex...);
+	}
+	multi_flat_view_t<T,Dim> view() {return multi_flat_view_t<T,Dim>(storage.data(), extents, strides);}
+	multi_flat_view_t<const T,Dim> view() const {return multi_flat_view_t<const T,Dim>(storage.data(), extents, strides);}
+	template<std::size_t D = Dim>
+	typename std::enable_if<(D > 1), multi_flat_view_t<T,Dim-1>>::type slice(int i) {return view().slice(i);}
+	template<std::size_t D = Dim>
+	typename std::enable_if<(D > 1), multi_flat_view_t<const T,Dim-1>>::type slice(int i) const {return view().slice(i);}
+	void fill(const T& value)
+	{
+		std::fill(storage.begin(), storage.end(), value);
+	}
+	int size(std::size_t d = 0) const {return extents.at(d);}
+	const std::array<int,Dim>& getExtents() const {return extents;}
+	const std::array<int,Dim>& getStrides() const {return strides;}
+	T* data() {return storage.data();}
+	const T* data() const {return storage.data();}
+};
+
+#endif /* MULTI_ARRAY_H__ */
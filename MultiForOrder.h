@@ -0,0 +1,259 @@
+#ifndef MULTI_FOR_ORDER_H__
+#define MULTI_FOR_ORDER_H__
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+/*
+   Orders in which MultiForVar (MultiForVar.h, and the one in WindowIterator.h) visits its box,
+     as its second template parameter:
+
+	MultiForVar<3, MultiForTiled<16>> var({0,0,0}, {n,n,n});   //16x16x16 tiles
+	MultiForVar<3, MultiForTiled<4,8,64>> var({0,0,0}, {n,n,n}); //4x8x64 tiles
+	MultiForVar<3, MultiForHilbert> var({0,0,0}, {n,n,n});
+	for(; !var.done(); ++var)
+		stencil(var.index<0>(), var.index<1>(), var.index<2>());
+
+   MultiForRowMajor:  the last index changing fastest (the default)
+   MultiForTiled:     row major between tiles of the given sizes, and row major within each tile, so a
+                        stencil's neighbors are still in the cache when it comes back to them; the tile
+						sizes are one for every dimension, or one per dimension
+   MultiForMorton:    Z order, recursively by halves of every dimension, which suits every cache size
+                        at once without choosing a tile size
+   MultiForHilbert:   as Morton, but consecutive indexes are always neighbors
+   The space filling curves cover the box with the smallest power of two cube, and jump over the parts of
+     it outside the box a whole aligned block at a time: the box can be any shape, as long as the cube
+	 has less than 2^64 elements.
+*/
+
+struct MultiForRowMajor {};
+
+template<int...Tiles>
+struct MultiForTiled {
+	static_assert(sizeof...(Tiles) > 0);
+	static_assert(((Tiles > 0) and ...), "tile sizes must be positive");
+	template<std::size_t Dim>
+	static int tile(std::size_t d)
+	{
+		static_assert(sizeof...(Tiles) == 1 or sizeof...(Tiles) == Dim, "one tile size, or one per dimension");
+		constexpr std::array<int,sizeof...(Tiles)> tiles{Tiles...};
+		return tiles[sizeof...(Tiles) == 1 ? 0 : d];
+	}
+};
+
+//bit level*Dim + t of a code is bit level of dimension Dim-1-t, so that the first dimension is the
+//most significant, as in row major order
+struct MultiForMorton {
+	template<std::size_t Dim>
+	static void decode(std::uint64_t code, int levels, std::array<int,Dim>& p)
+	{
+		p.fill(0);
+		for(int level = 0; level < levels; ++level)
+			for(std::size_t t = 0; t < Dim; ++t, code >>= 1)
+				p[Dim-1-t] |= int(code & 1) << level;
+	}
+	//++code, updating p only at the bits that change: O(1) amortized
+	template<std::size_t Dim>
+	static void advance(std::uint64_t& code, int, std::array<int,Dim>& p)
+	{
+		if( (code & 1) == 0 )
+		{
+			p[Dim-1] |= 1;
+			++code;
+			return;
+		}
+		for(std::size_t j = 0; ; ++j)
+		{
+			int& c = p[Dim-1-j%Dim];
+			const int bit = 1 << (j/Dim);
+			if( (code >> j) & 1 )
+				c &= ~bit;
+			else
+			{
+				c |= bit;
+				break;
+			}
+		}
+		++code;
+	}
+};
+
+//J. Skilling, "Programming the Hilbert curve" (2004): the Hilbert index, in the same bit layout as a
+//Morton code, transformed to the coordinates; every index is decoded whole, so Hilbert order costs
+//O(levels*Dim) per index where Morton order costs O(1)
+struct MultiForHilbert {
+	template<std::size_t Dim>
+	static void decode(std::uint64_t code, int levels, std::array<int,Dim>& p)
+	{
+		MultiForMorton::decode(code, levels, p);
+		if( levels == 0 )
+			return;
+		//Gray decode
+		const int top = p[Dim-1] >> 1;
+		for(std::size_t i = Dim-1; i > 0; --i)
+			p[i] ^= p[i-1];
+		p[0] ^= top;
+		//undo the rotations and reflections
+		for(int q = 2; q != 2 << (levels-1); q <<= 1)
+		{
+			const int low = q - 1;
+			for(std::size_t i = Dim; i-- > 0;)
+			{
+				if( p[i] & q )
+					p[0] ^= low;
+				else
+				{
+					const int t = (p[0] ^ p[i]) & low;
+					p[0] ^= t;
+					p[i] ^= t;
+				}
+			}
+		}
+	}
+	template<std::size_t Dim>
+	static void advance(std::uint64_t& code, int levels, std::array<int,Dim>& p)
+	{
+		decode(++code, levels, p);
+	}
+};
+
+namespace details {
+
+//first() moves ind to the first index of [start,end), next() to the following one; after the last,
+//ind[0] is end[0]
+template<std::size_t Dim, class Order>
+class MultiForTraversal {
+public:
+	static_assert(std::is_same<Order,MultiForRowMajor>::value, "unknown MultiForVar order");
+};
+
+template<std::size_t Dim, int...Tiles>
+class MultiForTraversal<Dim,MultiForTiled<Tiles...>> {
+	std::array<int,Dim> start, end, tileStart, tileEnd;
+
+	void enterTile(std::array<int,Dim>& ind)
+	{
+		for(std::size_t d = 0; d < Dim; ++d)
+			tileEnd[d] = std::min(end[d], tileStart[d] + MultiForTiled<Tiles...>::template tile<Dim>(d));
+		ind = tileStart;
+	}
+public:
+	void first(std::array<int,Dim>& ind, const std::array<int,Dim>& start, const std::array<int,Dim>& end)
+	{
+		this->start = start;
+		this->end = end;
+		tileStart = start;
+		enterTile(ind);
+		for(std::size_t d = 0; d < Dim; ++d)
+			if( start[d] >= end[d] )
+				ind[0] = end[0];
+	}
+	inline void next(std::array<int,Dim>& ind)
+	{
+		if( ++ind[Dim-1] < tileEnd[Dim-1] )
+			return;
+		ind[Dim-1] = tileStart[Dim-1];
+		for(std::size_t d = Dim-1; d-- > 0;)
+		{
+			if( ++ind[d] < tileEnd[d] )
+				return;
+			ind[d] = tileStart[d];
+		}
+		for(std::size_t d = Dim; d-- > 0;)
+		{
+			tileStart[d] += MultiForTiled<Tiles...>::template tile<Dim>(d);
+			if( tileStart[d] < end[d] )
+			{
+				enterTile(ind);
+				return;
+			}
+			tileStart[d] = start[d];
+		}
+		ind[0] = end[0];
+	}
+};
+
+template<std::size_t Dim, class Curve>
+class MultiForCurveTraversal {
+	std::array<int,Dim> start, end, sizes, p;
+	std::uint64_t code = 0;
+	int levels = 0;
+
+	//from code on (p being its coordinates), to the first code inside the box
+	void seek(std::array<int,Dim>& ind)
+	{
+		while( (code >> (levels*Dim)) == 0 )
+		{
+			//the largest aligned block around p that is outside the box is contiguous in the curve
+			int skip = -1;
+			for(std::size_t d = 0; d < Dim; ++d)
+			{
+				if( p[d] < sizes[d] )
+					continue;
+				int level = levels;
+				while( ((p[d] >> level) << level) < sizes[d] )
+					--level;
+				skip = std::max(skip, level);
+			}
+			if( skip < 0 )
+			{
+				for(std::size_t d = 0; d < Dim; ++d)
+					ind[d] = start[d] + p[d];
+				return;
+			}
+			code = ((code >> (skip*Dim)) + 1) << (skip*Dim);
+			Curve::decode(code, levels, p);
+		}
+		ind[0] = end[0];
+	}
+public:
+	void first(std::array<int,Dim>& ind, const std::array<int,Dim>& start, const std::array<int,Dim>& end)
+	{
+		this->start = start;
+		this->end = end;
+		ind = start;
+		int largest = 0;
+		for(std::size_t d = 0; d < Dim; ++d)
+		{
+			sizes[d] = end[d] - start[d];
+			if( sizes[d] <= 0 )
+			{
+				ind[0] = end[0];
+				return;
+			}
+			largest = std::max(largest, sizes[d]);
+		}
+		while( (1 << levels) < largest )
+			++levels;
+		assert( levels*Dim < 64 );
+		code = 0;
+		Curve::decode(code, levels, p);
+		seek(ind);
+	}
+	inline void next(std::array<int,Dim>& ind)
+	{
+		Curve::advance(code, levels, p);
+		bool inside = (code >> (levels*Dim)) == 0;
+		for(std::size_t d = 0; d < Dim; ++d)
+			inside &= p[d] < sizes[d];
+		if( inside )
+		{
+			for(std::size_t d = 0; d < Dim; ++d)
+				ind[d] = start[d] + p[d];
+			return;
+		}
+		seek(ind);
+	}
+};
+
+template<std::size_t Dim>
+class MultiForTraversal<Dim,MultiForMorton> : public MultiForCurveTraversal<Dim,MultiForMorton> {};
+template<std::size_t Dim>
+class MultiForTraversal<Dim,MultiForHilbert> : public MultiForCurveTraversal<Dim,MultiForHilbert> {};
+
+} /* namespace details */
+
+#endif /* MULTI_FOR_ORDER_H__ */
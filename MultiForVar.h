@@ -1,14 +1,19 @@
 #ifndef MULTI_FOR_VAR_H__
 #define MULTI_FOR_VAR_H__
 
+#include "MultiForOrder.h"
+
 #include <array>
 #include <functional>
 
-template<std::size_t Dim>
+//Order: MultiForRowMajor, MultiForTiled<...>, MultiForMorton or MultiForHilbert (MultiForOrder.h)
+template<std::size_t Dim, class Order = MultiForRowMajor>
 class MultiForVar {
+	static constexpr bool rowMajor = std::is_same<Order,MultiForRowMajor>::value;
 	std::array<int,Dim> ind;
 	const std::array<int,Dim> start, end;
 	std::function<void(int i)> loopTrigger;
+	details::MultiForTraversal<Dim,Order> traversal;
 
 	template<int I>
 		inline void increment_helper()
@@ -29,14 +34,25 @@ class MultiForVar {
 	public:
 	MultiForVar(
 			const std::array<int,Dim>& start,
-			const std::array<int,Dim>& end) : ind{start}, start(start), end(end) {}
+			const std::array<int,Dim>& end) : ind{start}, start(start), end(end)
+	{
+		if constexpr ( !rowMajor )
+			traversal.first(ind, start, end);
+	}
+	//loopTrigger(I) is called when index I wraps around, which only row major order does
 	MultiForVar(
 			const std::array<int,Dim>& start,
 			const std::array<int,Dim>& end,
-			decltype(loopTrigger) loopTrigger) : ind{start}, start(start), end(end), loopTrigger(loopTrigger) {}
+			decltype(loopTrigger) loopTrigger) : ind{start}, start(start), end(end), loopTrigger(loopTrigger)
+	{
+		static_assert(rowMajor, "loop triggers need row major order");
+	}
 	bool done() {return index<0>() >= end.at(0);}
 	inline MultiForVar& operator++(){
-		increment_helper<Dim-1>(); //Dim-1 is least significant index
+		if constexpr ( rowMajor )
+			increment_helper<Dim-1>(); //Dim-1 is least significant index
+		else
+			traversal.next(ind);
 		return *this;
 	}
 	template<int I>
@@ -2,11 +2,29 @@
 #define MY_REGEX_H__
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <regex>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cmath>
+#include <charconv>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
 #include <type_traits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if !defined(PRINT_MATCHES)
 #define PRINT_MATCHES 0
 #endif
@@ -17,31 +35,38 @@
 
 namespace MyRegex {
 
+//one cache per thread, so that patterns can be matched concurrently (see MyRegexStream.h)
 class RegexCache {
-	std::map<std::string, std::regex> cache;
+	std::map<std::string, std::regex, std::less<>> cache;
 public:
 	static RegexCache& instance() {
-		static RegexCache inst;
+		thread_local RegexCache inst;
 		return inst;
 	}
-	std::regex get(std::string s)
+	const std::regex& get(const std::string& s)
 	{
-		if( cache.find(s) == cache.end() )
-			cache.emplace(std::make_pair(s, std::regex(s)));
-		assert( cache.find(s) != cache.end() );
-		return cache.find(s)->second;
+		auto found = cache.find(s);
+		if( found == cache.end() )
+			found = cache.emplace(s, std::regex(s)).first;
+		return found->second;
 	}
-	bool match(std::string s, std::string reg)
+	bool match(std::string_view s, const std::string& reg)
 	{
-		return std::regex_match(s, get(reg));
+		return std::regex_match(s.begin(), s.end(), get(reg));
 	}
-	bool match(std::string s, std::smatch& sm, std::string reg)
+	bool match(std::string_view s, std::cmatch& sm, const std::string& reg)
 	{
-		return std::regex_match(s, sm, get(reg));
+		return std::regex_match(s.begin(), s.end(), sm, get(reg));
 	}
 
 };
 
+//view of a (sub-)match, pointing into the string that was matched against
+inline std::string_view matchView(const std::csub_match& m)
+{
+	return std::string_view(m.first, m.length());
+}
+
 /*
    A regex tree is composed of nodes, each node represents a regex pattern and
     possibly contains the values that the node is matched against (each node type
@@ -50,18 +75,23 @@ public:
     concatenation.
   Each node must provide the following API:
 		std::string regex();
-		bool match(std::string);
+		bool match(std::string_view);
 		static const int NumContained = ...;
 		template<int I> auto get();
 		template<int I> bool isSet();
 		void clear();
-  All nodes must handle regex() and match(std::string); this is how the node is
+  All nodes must handle regex() and match(std::string_view); this is how the node is
     matched to a target string. regex() should return a string with no captures;
-	match(std::string) uses a string with captures instead. This allows composed nodes
+	match(std::string_view) uses a string with captures instead. This allows composed nodes
 	to match using something similar to '(child1->regex())(child2->regex())', ie capturing
 	each string that matches the child nodes, and then passing that match to the child
 	node to process.
-  If the node captures data, then it should do that during the match(std::string) function.
+  If the node captures data, then it should do that during the match(std::string_view) function.
+  The view passed to match() is only guaranteed to live for the duration of the call; composed
+    nodes pass views into the string they were given, so no substring is ever copied while
+	walking the tree.
+  Nodes that capture without copying (the *View variables, Repeat and DelimitedList) keep
+    views/offsets into the matched string, so it must outlive any get() of those captures.
   If the node captures data, then it should set the NumContained value to the number of 
     values it captures; this number is recursive, so if it contains children nodes 
 	(like concatenation does) then this value should be the sum of the number of captures
@@ -75,8 +105,81 @@ public:
   A node that captures data must be able to be cleared in in preparation for matching against
     a new string; this prevents old data from being retained if the new string does not capture
 	anything for that node (say, for optional data). clear() provides this functionality.
+  Optionally, a node can provide
+		void requiredLiterals(RequiredLiterals&);
+    which adds, left to right, the literal text that every string matching the node contains.
+	This is used by Prefilter to reject strings without running the regex engine. Nodes that
+	do not provide it are treated as matching arbitrary text.
 */
 
+//Literal text a matching string must contain: it must start with prefix, and contain each of
+//the inner literals, in order, after that.
+struct RequiredLiterals {
+	std::string prefix;
+	std::vector<std::string> inner;
+	bool prefixOpen = true; //nothing but literal text has been seen so far
+
+	void addLiteral(const std::string& literal)
+	{
+		if( literal.empty() ) return;
+		if( prefixOpen )
+			prefix += literal;
+		else
+			inner.push_back(literal);
+	}
+	//arbitrary text may follow
+	void addUnknown() {prefixOpen = false;}
+};
+
+namespace details {
+
+template<class T, class = void>
+struct hasRequiredLiterals : std::false_type {};
+template<class T>
+struct hasRequiredLiterals<T, std::void_t<decltype(std::declval<T&>().requiredLiterals(std::declval<RequiredLiterals&>()))>> : std::true_type {};
+
+template<class Node>
+void requiredLiterals(Node& node, RequiredLiterals& req)
+{
+	if constexpr (hasRequiredLiterals<Node>::value)
+		node.requiredLiterals(req);
+	else
+		req.addUnknown();
+}
+
+//position of needle in haystack, or std::string_view::npos; with SSE2, compares the first and
+//last byte of needle against 16 positions at once, and only verifies the candidates that match both
+inline std::size_t findLiteral(std::string_view haystack, std::string_view needle)
+{
+#if defined(__SSE2__)
+	const std::size_t n = needle.size();
+	if( n < 2 or haystack.size() < n+15 )
+		return haystack.find(needle);
+	const __m128i first = _mm_set1_epi8(needle.front());
+	const __m128i last  = _mm_set1_epi8(needle.back());
+	std::size_t i = 0;
+	for(; i + n + 15 <= haystack.size(); i += 16)
+	{
+		__m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + i));
+		__m128i blockLast  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + i + n - 1));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+		while( mask )
+		{
+			unsigned bit = __builtin_ctz(mask);
+			if( std::memcmp(haystack.data() + i + bit + 1, needle.data() + 1, n - 2) == 0 )
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+	std::size_t rest = haystack.substr(i).find(needle);
+	return rest == std::string_view::npos ? rest : i + rest;
+#else
+	return haystack.find(needle);
+#endif
+}
+
+} /* namespace details */
+
 std::string escapeString(std::string s)
 {
 	std::size_t pos = 0;
@@ -96,21 +199,64 @@ std::string escapeString(std::string s)
 
 struct Text {
 	std::string text;
-	Text(std::string text) : text(escapeString(text)) {}
+	std::string literal; //unescaped
+	Text(std::string text) : text(escapeString(text)), literal(text) {}
 
 	static const int NumContained = 0;
 	template<int I> void get(); //intentionally undefined
-	bool match(std::string s) {
+	bool match(std::string_view s) {
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against \"" << this->regex() << "\"" << std::endl;
 #endif
-		return RegexCache::instance().match(s, text);
+		return s == literal; //same as matching against the escaped regex, without the regex engine
 	}
 	std::string regex() {return text;}
+	void requiredLiterals(RequiredLiterals& req) {req.addLiteral(literal);}
 	void clear(){}
 	template<int I> bool isSet(){return false;}
 };
 
+namespace details {
+
+//converts the text matched by a Variable into its value; integral and floating point values
+//are parsed in place with std::from_chars, anything else goes through operator>>
+template<class T>
+void parseCapture(std::string_view s, T& value)
+{
+	if constexpr (std::is_same<T,std::string_view>::value)
+		value = s;
+	else if constexpr (std::is_same<T,std::string>::value)
+		value.assign(s.data(), s.size());
+	else if constexpr (std::is_same<T,char>::value)
+		value = s.empty() ? T{} : s.front();
+	else if constexpr ((std::is_integral<T>::value and !std::is_same<T,bool>::value) or std::is_floating_point<T>::value)
+	{
+		//operator>> accepted a leading '+', from_chars does not
+		if( s.size() > 1 and s.front() == '+' and s[1] != '-' )
+			s.remove_prefix(1);
+		if( std::from_chars(s.data(), s.data()+s.size(), value).ec == std::errc::result_out_of_range )
+		{
+			//saturated, as operator>> did: too large a magnitude gives the limit of that sign, too small a
+			//(floating point) one gives 0
+			const bool negative = !s.empty() and s.front() == '-';
+			if constexpr (std::is_floating_point<T>::value)
+				if( std::abs(std::strtold(std::string(s).c_str(), nullptr)) < 1 )
+				{
+					value = negative ? -T(0) : T(0);
+					return;
+				}
+			value = negative ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+		}
+	}
+	else
+	{
+		std::stringstream ss{std::string(s)};
+		ss >> value;
+	}
+}
+
+} /* namespace details */
+
 template<class T>
 struct Variable {
 	T value;
@@ -123,17 +269,14 @@ struct Variable {
 		static_assert(I == 0);
 		return value;
 	}
-	bool match(std::string s) {
+	bool match(std::string_view s) {
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against \"" << this->regex() << "\"" << std::endl;
 #endif
 		this->clear();
 		is_set = RegexCache::instance().match(s, this->regex());
 		if( is_set )
-		{
-			std::stringstream ss(s);
-			ss >> value;
-		}
+			details::parseCapture(s, value);
 		return is_set;
 	}
 	virtual std::string regex()=0;
@@ -160,10 +303,22 @@ struct AllNonWhitespace : public Variable<std::string> {
 	virtual std::string regex() override { return "[^\\s]+";}
 };
 
+//same as Word/AllNonWhitespace, but capture a view into the matched string instead of a copy
+struct WordView : public Variable<std::string_view> {
+	using Variable<std::string_view>::Variable;
+	virtual std::string regex() override {return "\\w+";}
+};
+
+struct AllNonWhitespaceView : public Variable<std::string_view> {
+	using Variable<std::string_view>::Variable;
+	virtual std::string regex() override { return "[^\\s]+";}
+};
+
 class Line {
 	std::string s;
 public:
 	operator std::string() {return s;}
+	operator std::string_view() const {return s;}
 	friend std::istream& operator >> (std::istream& is, Line& line) {
 		std::getline(is, line.s);
 		return is;
@@ -186,44 +341,119 @@ public:
 	}
 };
 
+//The elements matched by Repeat/DelimitedList, stored as 32-bit offsets into the matched string, which
+//therefore must be shorter than 4 GiB (setSource() throws std::length_error otherwise).
+//The matching sub-nodes are only rebuilt when the results are asked for, so matching a list
+//does not copy the sub-node (or its captures) once per element.
 template<class Sub>
-struct Repeat {
-	Sub sub;
-	Text count;
+class SpanList {
+	struct Span {
+		std::uint32_t offset, length;
+	};
+	std::string_view source;
+	std::vector<Span> spans;
+public:
 	typedef typename std::conditional<
 						Sub::NumContained == 1,
 						decltype(std::declval<Sub>().template get<0>()),
 						Sub
 					>::type ReturnType;
-	std::vector<ReturnType> results;
-	Repeat(Sub sub, Text count) : sub(sub), count(count) {}
+	void setSource(std::string_view s)
+	{
+		if( s.size() > std::numeric_limits<std::uint32_t>::max() )
+			throw std::length_error("MyRegex lists cannot match strings of 4 GiB or more");
+		source = s;
+	}
+	std::string_view getSource() const {return source;}
+	//element must be a view into the source
+	void push_back(std::string_view element)
+	{
+		assert( element.data() >= source.data() and element.data()+element.size() <= source.data()+source.size() );
+		spans.push_back(Span{std::uint32_t(element.data()-source.data()), std::uint32_t(element.size())});
+	}
+	std::size_t size() const {return spans.size();}
+	std::string_view operator[](std::size_t i) const {return source.substr(spans[i].offset, spans[i].length);}
+	void clear(){source = std::string_view(); spans.clear();}
+	std::vector<ReturnType> materialize(Sub sub) const
+	{
+		std::vector<ReturnType> ret;
+		ret.reserve(spans.size());
+		for(std::size_t i = 0; i < spans.size(); ++i)
+		{
+			bool subMatched = sub.match((*this)[i]);
+			assert( subMatched );
+			if constexpr (Sub::NumContained == 1)
+				ret.push_back(sub.template get<0>());
+			else
+				ret.push_back(sub);
+		}
+		return ret;
+	}
+};
+
+template<class Sub>
+struct Repeat {
+	Sub sub;
+	Text count;
+	std::size_t minCount, maxCount; //parsed from count, which is 'n', 'n,' or 'n,m'
+	typedef typename SpanList<Sub>::ReturnType ReturnType;
+	SpanList<Sub> results;
+	Repeat(Sub sub, Text count) : sub(sub), count(count)
+	{
+		char* end = nullptr;
+		minCount = std::strtoul(count.literal.c_str(), &end, 10);
+		maxCount = minCount;
+		if( *end == ',' )
+			maxCount = end[1] ? std::strtoul(end+1, nullptr, 10) : std::size_t(-1);
+	}
 	static const int NumContained = 1;
 	template<int I>
 	std::vector<ReturnType> get() {
-		return results;
+		return results.materialize(sub);
 	}
-	bool match(std::string s)
+	//number of matched elements, and the text of each, without rebuilding the sub-nodes
+	std::size_t size() const {return results.size();}
+	std::string_view element(std::size_t i) const {return results[i];}
+	bool match(std::string_view s)
 	{
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against \"" << this->regex() << "\"" << std::endl;
 #endif
 		this->clear();
-		if( !RegexCache::instance().match(s, this->regex()) )
-			return false;
-		std::regex regex = RegexCache::instance().get(sub.regex());
-		auto begin = std::sregex_iterator(s.begin(), s.end(), regex);
-		auto end = std::sregex_iterator();
-		for(std::sregex_iterator MI = begin; MI != end; ++MI)
+		const std::regex& regex = RegexCache::instance().get(sub.regex());
+		results.setSource(s);
+		//take elements off the front one at a time; this finds a match without backtracking for
+		//almost all patterns, and only when it fails is the whole repetition handed to the regex engine
+		std::size_t pos = 0;
+		std::cmatch sm;
+		while( pos < s.size() and results.size() < maxCount and
+				std::regex_search(s.data()+pos, s.data()+s.size(), sm, regex, std::regex_constants::match_continuous) and
+				sm.length() > 0 )
 		{
-			assert( sub.match(MI->str()) );
-			if constexpr (Sub::NumContained == 1)
-				results.push_back(sub.template get<0>());
-			else
-				results.push_back(sub);
+			results.push_back(s.substr(pos, sm.length()));
+			pos += sm.length();
 		}
+		if( pos == s.size() and results.size() >= minCount )
+			return true;
+
+		results.clear();
+		if( !RegexCache::instance().match(s, this->regex()) )
+			return false;
+		auto begin = std::cregex_iterator(s.data(), s.data()+s.size(), regex);
+		auto end = std::cregex_iterator();
+		results.setSource(s);
+		for(std::cregex_iterator MI = begin; MI != end; ++MI)
+			results.push_back(matchView((*MI)[0]));
 		return true;
 	}
 	std::string regex(){return "(?:" + sub.regex() + "){" + count.regex() + "}";} // non-capture
+	void requiredLiterals(RequiredLiterals& req)
+	{
+		//unless the count allows zero repetitions, the string starts with a match of sub
+		if( minCount > 0 )
+			details::requiredLiterals(sub, req);
+		req.addUnknown();
+	}
 	void clear(){results.clear();}
 	template<int I>
 	bool isSet(){static_assert(I < NumContained); return true;} //always 'set', even if empty
@@ -273,23 +503,28 @@ struct Sum {
 		else
 			return rhs.template isSet<I-Lhs::NumContained>();
 	}
-	bool match(std::string s)
+	bool match(std::string_view s)
 	{
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against sum \"" << this->regex() << "\"" << std::endl;
 #endif
 		this->clear();
-		std::smatch sm;
+		std::cmatch sm;
 		bool ret = RegexCache::instance().match(s, sm, "("+this->lhs.regex()+")("+this->rhs.regex()+")");
 		if( ret )
 		{
 			assert( sm.size() == 3 );
-			this->lhs.match(sm[1]);
-			this->rhs.match(sm[2]);
+			this->lhs.match(matchView(sm[1]));
+			this->rhs.match(matchView(sm[2]));
 		}
 		return ret;
 	}
 	std::string regex() {return this->lhs.regex() + this->rhs.regex();}
+	void requiredLiterals(RequiredLiterals& req)
+	{
+		details::requiredLiterals(this->lhs, req);
+		details::requiredLiterals(this->rhs, req);
+	}
 };
 
 template<class Lhs, class Rhs, bool Same=std::is_same<Lhs,Rhs>::value>
@@ -334,7 +569,7 @@ struct Or {
 				return rhs.template isSet<I-Lhs::NumContained>();
 		}
 	}
-	bool match(std::string s)
+	bool match(std::string_view s)
 	{
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against \"" << this->regex() << "\"" << std::endl;
@@ -343,10 +578,12 @@ struct Or {
 		bool ret = RegexCache::instance().match(s, this->regex());
 		if( ret )
 		{
+			bool subMatched = false;
 			if( RegexCache::instance().match(s, this->lhs.regex()) )
-				assert( this->lhs.match(s) );
+				subMatched = this->lhs.match(s);
 			else
-				assert( this->rhs.match(s) );
+				subMatched = this->rhs.match(s);
+			assert( subMatched );
 		}
 		return ret;
 	}
@@ -405,7 +642,7 @@ struct Optional {
 	decltype( std::declval<Sub>().template get<I>() ) get() {
 		return sub.template get<I>();
 	}
-	bool match(std::string s)
+	bool match(std::string_view s)
 	{
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against \"" << this->regex() << "\"" << std::endl;
@@ -413,11 +650,12 @@ struct Optional {
 		this->clear();
 		if( !RegexCache::instance().match(s, this->regex()) )
 			return false;
-		std::regex regex = RegexCache::instance().get(sub.regex());
-		auto begin = std::sregex_iterator(s.begin(), s.end(), regex);
-		auto end = std::sregex_iterator();
+		const std::regex& regex = RegexCache::instance().get(sub.regex());
+		auto begin = std::cregex_iterator(s.data(), s.data()+s.size(), regex);
+		auto end = std::cregex_iterator();
 		if ( begin != end ) {
-			assert( sub.match(begin->str()) );
+			bool subMatched = sub.match(matchView((*begin)[0]));
+			assert( subMatched );
 			++begin;
 			assert(begin == end);
 		}
@@ -434,72 +672,300 @@ template<class T,
 >
 Optional<T> operator &(T t) {return Optional<T>(t);}
 
+namespace details {
+
+//regex for the decimal numbers in [min,max], without leading zeros. The range is split into
+//pieces that share a prefix and end in full digit ranges, so range(0,100000) becomes
+//'(?:\d|[1-9]\d|[1-9]\d{2}|[1-9]\d{3}|[1-9]\d{4}|100000)' instead of 100001 alternatives.
+inline std::string unsignedRangeRegex(unsigned long long min, unsigned long long max)
+{
+	typedef unsigned __int128 Wide; //max+1 and the powers of 10 below may not fit in 64 bits
+	auto pow10 = [](int k) {Wide p = 1; while(k--) p *= 10; return p;};
+	std::vector<Wide> stops{max};
+	//ends of the pieces: min with its low digits set to 9, and max+1 with its low digits set to 0, minus one
+	for(int k = 1; ; ++k)
+	{
+		Wide stop = Wide(min) / pow10(k) * pow10(k) + pow10(k) - 1;
+		if( stop >= max ) break;
+		stops.push_back(stop);
+	}
+	for(int k = 1; ; ++k)
+	{
+		Wide end = (Wide(max)+1) / pow10(k) * pow10(k);
+		if( end <= min ) break;
+		if( end - 1 <= max ) stops.push_back(end-1);
+	}
+	std::sort(stops.begin(), stops.end());
+	stops.erase(std::unique(stops.begin(), stops.end()), stops.end());
+
+	std::string ret = "(?:";
+	Wide start = min;
+	for(Wide stop : stops)
+	{
+		if( stop < start ) continue;
+		//start and stop have the same number of digits; emit the common digits, then one
+		//digit range, then any number of full \d's
+		std::string from = std::to_string((unsigned long long)start), to = std::to_string((unsigned long long)stop);
+		assert( from.size() == to.size() );
+		if( start != min ) ret += "|";
+		int anyDigits = 0;
+		for(std::size_t i = 0; i < from.size(); ++i)
+		{
+			if( from[i] == '0' and to[i] == '9' )
+			{
+				++anyDigits;
+				continue;
+			}
+			if( from[i] == to[i] )
+				ret += from[i];
+			else
+				ret += std::string("[") + from[i] + "-" + to[i] + "]";
+		}
+		if( anyDigits )
+			ret += anyDigits == 1 ? "\\d" : "\\d{" + std::to_string(anyDigits) + "}";
+		start = stop + 1;
+	}
+	return ret + ")";
+}
+
+template<class T>
+std::string integerRangeRegex(T min, T max)
+{
+	typedef typename std::make_unsigned<T>::type U;
+	if( min >= 0 )
+		return unsignedRangeRegex(min, max);
+	//magnitudes of the negative part; computed in unsigned, as -min may not fit in T
+	U negLow = max < 0 ? U(0) - U(max) : 1;
+	U negHigh = U(0) - U(min);
+	std::string negative = "-" + unsignedRangeRegex(negLow, negHigh);
+	if( max < 0 )
+		return negative;
+	return "(?:" + negative + "|" + unsignedRangeRegex(0, max) + ")";
+}
+
+//character class for [min,max]; characters other than letters and digits are hex-escaped
+inline std::string charRangeRegex(unsigned char min, unsigned char max)
+{
+	auto escape = [](unsigned char c) {
+		if( std::isalnum(c) )
+			return std::string(1, c);
+		const char* hex = "0123456789abcdef";
+		return std::string("\\x") + hex[c >> 4] + hex[c & 0xf];
+	};
+	if( min == max )
+		return "[" + escape(min) + "]";
+	return "[" + escape(min) + "-" + escape(max) + "]";
+}
+
+} /* namespace details */
+
+//Matches values in [min,max]. The regex is built once on construction: integer ranges become
+//digit-range expressions, character ranges a character class, and anything else one alternative
+//per value.
 template<class T>
 class Range : public Variable<T> {
-public:
-	T min, max;
-	Range(T min, T max) : min(min), max(max) {}
-	virtual std::string regex() override {
-		std::stringstream ret;
-		ret << "(?:"; // non-capturing
-		for(auto i = min; i <= max; ++i)
+	std::string pattern;
+	static std::string makeRegex(T min, T max)
+	{
+		if( max < min )
+			return "(?!)"; //empty range, matches nothing
+		if constexpr (std::is_same<T,char>::value or std::is_same<T,signed char>::value or std::is_same<T,unsigned char>::value)
+			return details::charRangeRegex(min, max);
+		else if constexpr (std::is_integral<T>::value and !std::is_same<T,bool>::value)
+			return details::integerRangeRegex(min, max);
+		else
 		{
-			if( i != min ) ret << "|";
-			ret << i;
+			std::stringstream ret;
+			ret << "(?:"; // non-capturing
+			for(auto i = min; i <= max; ++i)
+			{
+				if( i != min ) ret << "|";
+				ret << i;
+			}
+			ret << ")";
+			return ret.str();
 		}
-		ret << ")";
-		return ret.str();
+	}
+public:
+	T min, max; //the regex is built from these on construction
+	Range(T min, T max) : pattern(makeRegex(min,max)), min(min), max(max) {}
+	virtual std::string regex() override {
+		return pattern;
+	}
+	bool match(std::string_view s) {
+		bool ret = Variable<T>::match(s);
+		assert( !ret or (this->value >= min and this->value <= max) );
+		return ret;
 	}
 };
 
 template<class T>
 Range<T> range(T min, T max) {return Range<T>(min,max);}
 
+//Elements of Sub separated by the delimiter. The input is split at every occurrence of the delimiter, and if every piece
+//matches Sub, those pieces are the elements: DelimitedList<AllNonWhitespace>(",") gives "a", "bb" and "ccc" for "a,bb,ccc",
+//even though AllNonWhitespace could also match the whole string. Only if some piece does not match Sub is the split left
+//to the regex sub >> *(delimiter >> sub), where elements may contain the delimiter (the earlier elements being as long as
+//possible, as std::regex backtracks).
 template<class Sub>
 class DelimitedList {
 	Sub sub;
-	std::string delimiter;
-	typedef typename std::conditional<
-						Sub::NumContained == 1,
-						decltype(std::declval<Sub>().template get<0>()),
-						Sub
-					>::type ReturnType;
-	std::vector<ReturnType> results;
+	std::string delimiter; //unescaped; Text escapes it
+	typedef Sum<Sub,Repeat<Sum<Text,Sub>>> ListType;
+	ListType list; //sub >> *(delimiter >> sub), for when the list cannot simply be split on the delimiter
+	typedef typename SpanList<Sub>::ReturnType ReturnType;
+	SpanList<Sub> results;
+
+	//splits s at each delimiter and checks each element against sub
+	bool splitMatch(std::string_view s)
+	{
+		if( delimiter.empty() )
+			return false;
+		const std::regex& regex = RegexCache::instance().get(sub.regex());
+		results.setSource(s);
+		while( true )
+		{
+			std::size_t pos = details::findLiteral(s, delimiter);
+			std::string_view element = s.substr(0, pos);
+			if( !std::regex_match(element.begin(), element.end(), regex) )
+				return false;
+			results.push_back(element);
+			if( pos == std::string_view::npos )
+				return true;
+			s.remove_prefix(pos + delimiter.size());
+		}
+	}
 public:
-	DelimitedList(Sub sub, std::string delimiter) : sub(sub), delimiter(escapeString(delimiter)) {}
+	DelimitedList(Sub sub, std::string delimiter) : sub(sub), delimiter(delimiter), list(sub >> *(Text{delimiter} >> sub)) {}
 	static const int NumContained = 1;
 	template<int I>
 	std::vector<ReturnType> get() {
-		return results;
+		return results.materialize(sub);
 	}
-	bool match(std::string s)
+	std::size_t size() const {return results.size();}
+	std::string_view element(std::size_t i) const {return results[i];}
+	bool match(std::string_view s)
 	{
 #if PRINT_MATCHES
 		std::cout << "matching \"" << s << "\" against \"" << this->regex() << "\"" << std::endl;
 #endif
 		this->clear();
-		auto Reg = sub >> *(Text{delimiter} >> sub);
-		if( !Reg.match(s) )
+		if( splitMatch(s) )
+			return true;
+		//the delimiter may also appear inside elements, so let the regex engine find the split
+		results.clear();
+		if( !list.match(s) )
 			return false;
-		if constexpr (Sub::NumContained == 1)
-		{
-			results = Reg.template get<1>();
-			results.insert(results.begin(), Reg.template get<0>());
-		}
-		else
-		{
-			results.push_back(Reg.lhs);
-			for(auto M : Reg.template get<Sub::NumContained>()) //M is a match for Text{delimiter} >> sub
-				results.push_back(M.rhs);
-		}
+		//the repeated part starts right after the first element; each of its elements is the
+		//delimiter followed by an element of the list
+		const SpanList<Sum<Text,Sub>>& rest = list.rhs.results;
+		results.setSource(s);
+		results.push_back(s.substr(0, rest.getSource().data() - s.data()));
+		for(std::size_t i = 0; i < rest.size(); ++i)
+			results.push_back(rest[i].substr(delimiter.size()));
 		return true;
 	}
-	std::string regex() {auto Reg = sub >> *(Text{delimiter} >> sub); return Reg.regex();}
+	std::string regex() {return list.regex();}
+	void requiredLiterals(RequiredLiterals& req)
+	{
+		details::requiredLiterals(sub, req);
+		req.addUnknown();
+	}
 	void clear(){results.clear();}
 	template<int I>
 	bool isSet(){return I < results.size();}
 };
 
+//Rejects strings that cannot match a pattern, by searching for the literal text the pattern
+//requires before the regex engine is run:
+//	MyRegex::Prefilter filter(pattern);
+//	if( filter.mayMatch(line) and pattern.match(line) ) ...
+//Keeps count of how many strings it checked and rejected.
+class Prefilter {
+	RequiredLiterals req;
+	std::size_t checked = 0;
+	std::size_t rejected = 0;
+	bool passes(std::string_view s) const
+	{
+		if( s.size() < req.prefix.size() or std::memcmp(s.data(), req.prefix.data(), req.prefix.size()) != 0 )
+			return false;
+		s.remove_prefix(req.prefix.size());
+		for(const std::string& L : req.inner)
+		{
+			std::size_t pos = details::findLiteral(s, L);
+			if( pos == std::string_view::npos )
+				return false;
+			s.remove_prefix(pos + L.size());
+		}
+		return true;
+	}
+public:
+	template<class Pattern>
+	explicit Prefilter(Pattern& pattern) {details::requiredLiterals(pattern, req);}
+	//true if the pattern has no required literals, so every string passes
+	bool empty() const {return req.prefix.empty() and req.inner.empty();}
+	bool mayMatch(std::string_view s)
+	{
+		++checked;
+		bool ret = passes(s);
+		if( !ret )
+			++rejected;
+		return ret;
+	}
+	std::size_t getChecked() const {return checked;}
+	std::size_t getRejected() const {return rejected;}
+	double rejectionRate() const {return checked ? double(rejected) / checked : 0;}
+};
+
+//Matches a string against many patterns at once, picking the first pattern (in the order they
+//were given) that matches. All patterns are combined into one regex '(p0)|(p1)|...', so a string
+//is scanned once no matter how many patterns there are; only the pattern that matched is then
+//asked to capture its data:
+//	MyRegex::PatternSet set(patternA, patternB, patternC);
+//	switch( set.match(line) ) {
+//		case 0: use(set.get<0>().get<0>()); break;
+//		case 1: ...
+//		case -1: //nothing matched
+//	}
+//Only the captures of the pattern that matched last are meaningful.
+template<class...Patterns>
+class PatternSet {
+	std::tuple<Patterns...> patterns;
+	std::string combined;
+	template<std::size_t...I>
+	std::string combine(std::index_sequence<I...>)
+	{
+		std::string ret;
+		((ret += (I ? "|(" : "(") + std::get<I>(patterns).regex() + ")"), ...);
+		return ret;
+	}
+	template<std::size_t...I>
+	int dispatch(std::string_view s, const std::cmatch& sm, std::index_sequence<I...>)
+	{
+		int ret = -1;
+		//regex() of a node has no captures, so group I+1 is pattern I
+		(void)((sm[I+1].matched and (ret = I, true)) or ...);
+		bool subMatched = false;
+		(void)((ret == int(I) and (subMatched = std::get<I>(patterns).match(s), true)) or ...);
+		assert( ret == -1 or subMatched );
+		return ret;
+	}
+public:
+	static const int NumPatterns = sizeof...(Patterns);
+	PatternSet(Patterns...patterns) : patterns(patterns...), combined(combine(std::index_sequence_for<Patterns...>{})) {}
+	//index of the first pattern that matches s, or -1 if none do
+	int match(std::string_view s)
+	{
+		std::cmatch sm;
+		if( !RegexCache::instance().match(s, sm, combined) )
+			return -1;
+		return dispatch(s, sm, std::index_sequence_for<Patterns...>{});
+	}
+	template<int I>
+	auto& get() {return std::get<I>(patterns);}
+	std::string regex() {return combined;}
+};
+
 auto Digit = range(0,9);
 auto LowerCase = range('a','z');
 auto UpperCase = range('A','Z');
@@ -0,0 +1,255 @@
+#ifndef MY_REGEX_STREAM_H__
+#define MY_REGEX_STREAM_H__
+
+#include "MyRegex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+   Streaming line matcher for MyRegex patterns.
+   Instead of reading each Line into a std::string and calling match() on it, the whole
+     input (a file mapped into memory, or any other buffer) is split at line boundaries
+	 across threads, and the pattern is matched against each line as a std::string_view.
+   Each thread works on its own copy of the pattern (nodes hold their captures), and
+     RegexCache is per-thread, so no locking happens on the matching path.
+   Lines that lack the literal text the pattern requires are rejected by a Prefilter
+     before the regex engine runs; StreamStats reports how many were.
+   Captures are either handed to a callback, or written into preallocated columns with one
+     row per line of input:
+
+	auto pattern = "ERROR " >> MyRegex::Word{} >> " " >> MyRegex::Integer{};
+	MyRegex::MappedFile file("huge.log");
+	MyRegex::MatchColumns<decltype(pattern)> columns;
+	MyRegex::StreamStats stats = MyRegex::matchLines(pattern, file.view(), columns);
+	for(std::size_t row = 0; row < columns.size(); ++row)
+		if( columns.matched[row] )
+			use(*columns.column<0>()[row], *columns.column<1>()[row]);
+	std::cout << stats.linesPerSecond() << " lines/s\n";
+*/
+
+namespace MyRegex {
+
+//read-only memory mapping of a whole file
+class MappedFile {
+	const char* data = nullptr;
+	std::size_t length = 0;
+public:
+	explicit MappedFile(const std::string& path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if( fd < 0 )
+			throw std::runtime_error("Cannot open file '" + path + "'!");
+		struct stat st;
+		if( ::fstat(fd, &st) != 0 )
+		{
+			::close(fd);
+			throw std::runtime_error("Cannot stat file '" + path + "'!");
+		}
+		length = st.st_size;
+		if( length )
+		{
+			void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if( mapped == MAP_FAILED )
+			{
+				::close(fd);
+				throw std::runtime_error("Cannot map file '" + path + "'!");
+			}
+			::madvise(mapped, length, MADV_SEQUENTIAL);
+			data = static_cast<const char*>(mapped);
+		}
+		::close(fd);
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+	~MappedFile()
+	{
+		if( data )
+			::munmap(const_cast<char*>(data), length);
+	}
+	std::string_view view() const {return std::string_view(data, length);}
+};
+
+struct StreamStats {
+	std::size_t lines = 0;
+	std::size_t matched = 0;
+	std::size_t rejected = 0; //lines rejected by the prefilter, without running the regex engine
+	double seconds = 0;
+	double linesPerSecond() const {return seconds > 0 ? lines / seconds : 0;}
+	double rejectionRate() const {return lines ? double(rejected) / lines : 0;}
+};
+
+//one row per line of input; columns hold the captures of matched lines (unset for unmatched
+//lines, or for captures that did not participate in the match)
+template<class Pattern>
+class MatchColumns {
+	template<int I>
+	using CaptureType = typename std::decay<decltype(std::declval<Pattern&>().template get<I>())>::type;
+	template<std::size_t...I>
+	static std::tuple<std::vector<std::optional<CaptureType<I>>>...> columnsType(std::index_sequence<I...>);
+	template<std::size_t...I>
+	void resizeHelper(std::size_t rows, std::index_sequence<I...>)
+	{
+		(std::get<I>(columns).assign(rows, std::nullopt), ...);
+	}
+	template<std::size_t...I>
+	void storeHelper(std::size_t row, Pattern& p, std::index_sequence<I...>)
+	{
+		((p.template isSet<I>() ? (void)(std::get<I>(columns)[row] = p.template get<I>()) : (void)0), ...);
+	}
+public:
+	typedef decltype(columnsType(std::make_index_sequence<Pattern::NumContained>{})) ColumnsType;
+	std::vector<char> matched; //not std::vector<bool>, so that rows can be written from different threads
+	ColumnsType columns;
+
+	std::size_t size() const {return matched.size();}
+	void resize(std::size_t rows)
+	{
+		matched.assign(rows, false);
+		resizeHelper(rows, std::make_index_sequence<Pattern::NumContained>{});
+	}
+	template<int I>
+	auto& column() {return std::get<I>(columns);}
+	void store(std::size_t row, Pattern& p)
+	{
+		matched[row] = true;
+		storeHelper(row, p, std::make_index_sequence<Pattern::NumContained>{});
+	}
+};
+
+namespace details {
+
+//split buffer into (at most) parts pieces, each ending just past a newline (or at the end of buffer)
+inline std::vector<std::string_view> splitAtLines(std::string_view buffer, unsigned parts)
+{
+	std::vector<std::string_view> ret;
+	std::size_t approx = std::max<std::size_t>(buffer.size() / std::max(parts,1u), 1);
+	std::size_t begin = 0;
+	while( begin < buffer.size() )
+	{
+		std::size_t end = begin + approx;
+		if( end >= buffer.size() )
+			end = buffer.size();
+		else
+		{
+			end = buffer.find('\n', end-1);
+			end = (end == std::string_view::npos) ? buffer.size() : end+1;
+		}
+		ret.push_back(buffer.substr(begin, end-begin));
+		begin = end;
+	}
+	return ret;
+}
+
+//number of lines as std::getline would see them - a trailing newline does not start a new line
+inline std::size_t countLines(std::string_view chunk)
+{
+	if( chunk.empty() ) return 0;
+	std::size_t count = std::count(chunk.begin(), chunk.end(), '\n');
+	return count + (chunk.back() != '\n');
+}
+
+//calls func(line, lineView) for every line of chunk
+template<class Func>
+void forEachLine(std::string_view chunk, std::size_t firstLine, Func&& func)
+{
+	std::size_t line = firstLine;
+	while( !chunk.empty() )
+	{
+		const char* nl = static_cast<const char*>(std::memchr(chunk.data(), '\n', chunk.size()));
+		std::size_t len = nl ? nl - chunk.data() : chunk.size();
+		func(line++, chunk.substr(0, len));
+		chunk.remove_prefix(nl ? len+1 : len);
+	}
+}
+
+} /* namespace details */
+
+//matches pattern against every line of buffer, calling func(lineNumber, matchedPattern) for each line
+//that matches. func is called concurrently from the worker threads, each with its own copy of pattern.
+template<class Pattern, class Func>
+StreamStats matchLines(const Pattern& pattern, std::string_view buffer, Func func,
+		unsigned threads = std::thread::hardware_concurrency())
+{
+	auto startTime = std::chrono::steady_clock::now();
+	std::vector<std::string_view> chunks = details::splitAtLines(buffer, threads);
+
+	//first pass: count lines per chunk, so each chunk knows the number of its first line
+	std::vector<std::size_t> firstLine(chunks.size()+1, 0);
+	{
+		std::vector<std::thread> workers;
+		for(std::size_t i = 0; i < chunks.size(); ++i)
+			workers.emplace_back([&,i]{firstLine[i+1] = details::countLines(chunks[i]);});
+		for(auto& W : workers)
+			W.join();
+	}
+	for(std::size_t i = 0; i < chunks.size(); ++i)
+		firstLine[i+1] += firstLine[i];
+
+	//second pass: match
+	std::vector<std::size_t> matched(chunks.size(), 0);
+	std::vector<std::size_t> rejected(chunks.size(), 0);
+	{
+		std::vector<std::thread> workers;
+		for(std::size_t i = 0; i < chunks.size(); ++i)
+			workers.emplace_back([&,i]{
+				Pattern local = pattern;
+				Prefilter filter(local);
+				std::size_t localMatched = 0;
+				details::forEachLine(chunks[i], firstLine[i], [&](std::size_t line, std::string_view s) {
+					if( filter.mayMatch(s) and local.match(s) )
+					{
+						++localMatched;
+						func(line, local);
+					}
+				});
+				matched[i] = localMatched;
+				rejected[i] = filter.getRejected();
+			});
+		for(auto& W : workers)
+			W.join();
+	}
+
+	StreamStats stats;
+	stats.lines = firstLine.back();
+	for(auto M : matched)
+		stats.matched += M;
+	for(auto R : rejected)
+		stats.rejected += R;
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return stats;
+}
+
+//matches pattern against every line of buffer, storing the captures of each line in columns
+template<class Pattern>
+StreamStats matchLines(const Pattern& pattern, std::string_view buffer, MatchColumns<Pattern>& columns,
+		unsigned threads = std::thread::hardware_concurrency())
+{
+	columns.resize(details::countLines(buffer));
+	return matchLines(pattern, buffer, [&](std::size_t line, Pattern& p) {columns.store(line, p);}, threads);
+}
+
+//the file is unmapped on return, so patterns capturing views into the input need matchLines
+//with a MappedFile that outlives the columns instead
+template<class Pattern>
+StreamStats matchFile(const Pattern& pattern, const std::string& path, MatchColumns<Pattern>& columns,
+		unsigned threads = std::thread::hardware_concurrency())
+{
+	MappedFile file(path);
+	return matchLines(pattern, file.view(), columns, threads);
+}
+
+} /* namespace MyRegex */
+
+#endif /* MY_REGEX_STREAM_H__ */
@@ -0,0 +1,133 @@
+#ifndef THREAD_POOL_H__
+#define THREAD_POOL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+   A fixed set of worker threads for data-parallel loops:
+
+	ThreadPool pool; //one thread per core, including the calling thread
+	pool.parallelFor(0, n, 1024, [&](std::size_t i) {out[i] = f(in[i]);});
+
+   parallelFor blocks until every index has been processed; the calling thread works too.
+   The range is divided evenly between the threads, and each thread takes chunks of grain
+     indexes off the front of its own share. A thread that runs out of work steals chunks from
+	 the shares of the other threads, so uneven work per index still keeps every thread busy.
+   Jobs cannot be nested: func must not call parallelFor on the same pool.
+*/
+
+class ThreadPool {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	std::function<void(unsigned worker)> job;
+	unsigned generation = 0;
+	unsigned running = 0;
+	bool stopping = false;
+
+	void workerLoop(unsigned worker)
+	{
+		unsigned seen = 0;
+		while( true )
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]{return stopping or generation != seen;});
+			if( stopping ) return;
+			seen = generation;
+			lock.unlock();
+			job(worker);
+			lock.lock();
+			if( --running == 0 )
+				finished.notify_one();
+		}
+	}
+	//runs job(worker) once on every thread, worker 0 being the calling thread
+	void run(std::function<void(unsigned worker)> func)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = std::move(func);
+			running = workers.size();
+			++generation;
+		}
+		wake.notify_all();
+		job(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&]{return running == 0;});
+	}
+public:
+	explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency())
+	{
+		for(unsigned i = 1; i < threads; ++i)
+			workers.emplace_back([this,i]{workerLoop(i);});
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(auto& W : workers)
+			W.join();
+	}
+	//number of threads that run a job, including the calling thread
+	unsigned size() const {return workers.size() + 1;}
+
+	//calls func(i) for every i in [begin,end)
+	template<class Func>
+	void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, Func&& func)
+	{
+		parallelForWorker(begin, end, grain, [&](unsigned, std::size_t i) {func(i);});
+	}
+	//calls func(worker, i) for every i in [begin,end), where worker in [0,size()) identifies the calling thread
+	template<class Func>
+	void parallelForWorker(std::size_t begin, std::size_t end, std::size_t grain, Func&& func)
+	{
+		if( begin >= end ) return;
+		if( grain == 0 ) grain = 1;
+		const unsigned threads = size();
+		if( threads == 1 or end - begin <= grain )
+		{
+			for(std::size_t i = begin; i < end; ++i)
+				func(0u, i);
+			return;
+		}
+		struct alignas(64) Share {
+			std::atomic<std::size_t> next;
+			std::size_t end;
+		};
+		std::vector<Share> shares(threads);
+		const std::size_t per = (end - begin + threads - 1) / threads;
+		for(unsigned t = 0; t < threads; ++t)
+		{
+			shares[t].next = std::min(end, begin + t*per);
+			shares[t].end = std::min(end, begin + (t+1)*per);
+		}
+		run([&](unsigned worker) {
+			//own share first, then the others, starting with the next thread's
+			for(unsigned s = 0; s < threads; ++s)
+			{
+				Share& share = shares[(worker + s) % threads];
+				while( true )
+				{
+					std::size_t chunk = share.next.fetch_add(grain);
+					if( chunk >= share.end ) break;
+					std::size_t chunkEnd = std::min(share.end, chunk + grain);
+					for(std::size_t i = chunk; i < chunkEnd; ++i)
+						func(worker, i);
+				}
+			}
+		});
+	}
+};
+
+#endif /* THREAD_POOL_H__ */
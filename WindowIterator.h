@@ -1,18 +1,27 @@
 #ifndef WINDOW_ITERATOR_H__
 #define WINDOW_ITERATOR_H__
 
+#include "MultiArray.h"
+#include "MultiForOrder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
 #include <vector>
 #include <array>
 #include <string>
+#include <type_traits>
+#include <cassert>
 
 /*
    MULTIFORVAR
 */
 
-template<int Dim>
+//end is inclusive here; Order as for MultiForVar.h (MultiForOrder.h)
+template<int Dim, class Order = MultiForRowMajor>
 class MultiForVar {
 	std::array<int,Dim> ind;
 	const std::array<int,Dim> start, end;
+	details::MultiForTraversal<Dim,Order> traversal;
 
 	template<int I>
 	inline void increment_helper()
@@ -20,11 +29,11 @@ class MultiForVar {
 		static_assert(I < Dim);
 		const int ind = Dim-I-1;
 		++index<ind>();
-		if( index<ind>() > end.at(I) )
+		if( index<ind>() > end.at(ind) )
 		{
 			if constexpr ( I+1 < Dim )
 			{
-				index<ind>() = start.at(I);
+				index<ind>() = start.at(ind);
 				increment_helper<I+1>();
 			}
 		}
@@ -32,10 +41,22 @@ class MultiForVar {
 public:	
 	MultiForVar(
 		const std::array<int,Dim>& start,
-		const std::array<int,Dim>& end) : ind{start}, start(start), end(end) {}
+		const std::array<int,Dim>& end) : ind{start}, start(start), end(end)
+	{
+		if constexpr ( !std::is_same<Order,MultiForRowMajor>::value )
+		{
+			std::array<int,Dim> stop;
+			for(int d = 0; d < Dim; ++d)
+				stop[d] = end[d] + 1;
+			traversal.first(ind, start, stop);
+		}
+	}
 	bool done() {return index<0>() > end.at(0);}
 	inline MultiForVar& operator++() {
-		increment_helper<0>();
+		if constexpr ( std::is_same<Order,MultiForRowMajor>::value )
+			increment_helper<0>();
+		else
+			traversal.next(ind);
 		return *this;
 	}
 	template<int I>
@@ -54,50 +75,208 @@ public:
    WINDOW ITERATOR
 */
 
+// should provide:
+//   static auto& GetElementAtIndex(T& t, int i);          - bounds checked
+//   static auto& GetElementAtIndexUnchecked(T& t, int i); - not checked, for WindowUnchecked
+//   static int GetMaxSize(T& t);
+// and for containers that have views (MultiArray.h), static auto GetView(T& t)
 template<class T> struct WindowIteratorHelper;
 
 template<class T>
 struct WindowIteratorHelper<std::vector<T>> {
 	static T& GetElementAtIndex(std::vector<T>& t, int i) {return t.at(i);}
+	static T& GetElementAtIndexUnchecked(std::vector<T>& t, int i) {return t[i];}
 	static int GetMaxSize(std::vector<T>& t){return t.size();}
 };
 
 template<class T, std::size_t N>
 struct WindowIteratorHelper<std::array<T,N>> {
 	static T& GetElementAtIndex(std::array<T,N>& t, int i) {return t.at(i);}
+	static T& GetElementAtIndexUnchecked(std::array<T,N>& t, int i) {return t[i];}
 	static int GetMaxSize(std::array<T,N>& t){return N;}
 };
 
 template<>
 struct WindowIteratorHelper<std::string> {
 	static auto& GetElementAtIndex(std::string& t, int i) {return t.at(i);}
+	static auto& GetElementAtIndexUnchecked(std::string& t, int i) {return t[i];}
 	static int GetMaxSize(std::string& t){return t.size();}
 };
 
-template<class T, int Dim>
+//How WindowIterator::get reaches the elements. WindowChecked checks every index at every level.
+//WindowUnchecked relies on the window positions being within the data by construction, and on the
+//  offsets passed to get() being within the window, which is only asserted (in debug builds). The
+//  positions come from the sizes of the first element at every level, so the data must be rectangular:
+//  nested containers (std::vector<std::vector<T>>, multi_vector_t) with shorter rows are read past their end.
+struct WindowChecked {
+	template<class A>
+	static decltype(auto) element(A& a, int i) {return WindowIteratorHelper<std::decay_t<A>>::GetElementAtIndex(a, i);}
+};
+struct WindowUnchecked {
+	template<class A>
+	static decltype(auto) element(A& a, int i) {return WindowIteratorHelper<std::decay_t<A>>::GetElementAtIndexUnchecked(a, i);}
+};
+
+//A contiguous part [getBegin(),getEnd()) of the window positions, numbered in the order WindowIterator
+//  visits them (the last dimension changing fastest). Ranges split into disjoint ranges, to share the
+//  positions out between threads.
+template<int Dim>
+class WindowRange {
+	std::array<int,Dim> positions; //per dimension
+	std::size_t begin, end;
+public:
+	WindowRange(const std::array<int,Dim>& positions, std::size_t begin, std::size_t end) :
+			positions(positions), begin(begin), end(end) {}
+	//all the positions
+	explicit WindowRange(const std::array<int,Dim>& positions) : positions(positions), begin(0), end(1)
+	{
+		for(int d = 0; d < Dim; ++d)
+			end *= std::max(positions[d], 0);
+	}
+	std::size_t getBegin() const {return begin;}
+	std::size_t getEnd() const {return end;}
+	std::size_t size() const {return end - begin;}
+	bool empty() const {return begin == end;}
+	const std::array<int,Dim>& getPositions() const {return positions;}
+	//the window position numbered i
+	std::array<int,Dim> position(std::size_t i) const
+	{
+		std::array<int,Dim> ret;
+		for(int d = Dim-1; d >= 0; --d)
+		{
+			ret[d] = i % positions[d];
+			i /= positions[d];
+		}
+		return ret;
+	}
+	//keeps the first half and returns the second
+	WindowRange split()
+	{
+		const std::size_t middle = begin + size()/2;
+		WindowRange ret(positions, middle, end);
+		end = middle;
+		return ret;
+	}
+	//the b-th of blocks disjoint ranges that together cover this one
+	WindowRange block(std::size_t b, std::size_t blocks) const
+	{
+		return WindowRange(positions, begin + size()*b/blocks, begin + size()*(b+1)/blocks);
+	}
+};
+
+//How the windows are laid out over the data. Position p of a dimension has its window's first element
+//  at p*Stride - (padding before), and offset i of get() is Dilation*i elements further.
+//  Valid:  only windows entirely within the data (the default)
+//  Same:   ceil(size/Stride) positions, centered; elements outside the data read as T() through get()
+//  Wrap:   as Same, with the elements outside the data taken from the other side
+//Stride and Dilation are compile time constants, the same in every dimension, so that the dense
+//  WindowMode<> costs nothing over the plain index arithmetic. 0 means they are given per dimension at run
+//  time, to the constructor of WindowIterator (WindowRuntime).
+enum class WindowPadding {Valid, Same, Wrap};
+
+template<int S = 1, int D = 1, WindowPadding P = WindowPadding::Valid>
+struct WindowMode {
+	static_assert(S >= 0 and D >= 0);
+	static_assert((S == 0) == (D == 0), "stride and dilation are either both constants or both given at run time");
+	static constexpr int Stride = S;
+	static constexpr int Dilation = D;
+	static constexpr WindowPadding Padding = P;
+};
+template<WindowPadding P = WindowPadding::Valid>
+using WindowRuntime = WindowMode<0,0,P>;
+
+template<class T, int Dim, class Access = WindowChecked, class Mode = WindowMode<>>
 class WindowIterator {
+	template<class, int, class, class> friend class WindowIterator;
 	T& data;
 	std::array<int,Dim> ind;
 	const std::array<int,Dim> win_size;
+	//only used when Mode leaves them to run time
+	const std::array<int,Dim> strides, dilations;
+	//sizes of data and window positions per dimension, from when the iterator was made: the
+	//container is not queried again while iterating, so it must not be resized meanwhile
+	std::array<int,Dim> extents{}, positions{}, before{};
+
+	static constexpr bool padded = Mode::Padding != WindowPadding::Valid;
 
+	int stride(int d) const
+	{
+		if constexpr ( Mode::Stride > 0 )
+			return Mode::Stride;
+		else
+			return strides[d];
+	}
+	int dilation(int d) const
+	{
+		if constexpr ( Mode::Dilation > 0 )
+			return Mode::Dilation;
+		else
+			return dilations[d];
+	}
+	//where offset i of the window is in the data, in dimension I
+	template<int I>
+	inline int coordinate(int i) const
+	{
+		if constexpr ( !padded )
+			return ind[I]*stride(I) + i*dilation(I);
+		else if constexpr ( Mode::Padding == WindowPadding::Same )
+			return ind[I]*stride(I) - before[I] + i*dilation(I);
+		else
+		{
+			const int c = (ind[I]*stride(I) - before[I] + i*dilation(I)) % extents[I];
+			return c < 0 ? c + extents[I] : c;
+		}
+	}
+	template<int I, typename...RestIndexes>
+	bool inside(int i, RestIndexes...rest) const
+	{
+		const int c = coordinate<I>(i);
+		if( c < 0 or c >= extents[I] )
+			return false;
+		if constexpr (sizeof...(rest) == 0)
+			return true;
+		else
+			return inside<I+1>(rest...);
+	}
+	//a helper may return a sub-container by value (a view), hence the forwarding references
 	template<int I, typename A, typename...RestIndexes>
-	inline auto& get_partial(A& a, int i, RestIndexes...rest)
+	inline auto& get_partial(A&& a, int i, RestIndexes...rest)
 	{
 		static_assert( sizeof...(rest)+1 == Dim-I );
+		assert( (std::is_same<Access,WindowChecked>::value or (i >= 0 and i < win_size[I])) );
 		if constexpr (sizeof...(rest) == 0)
-			return  WindowIteratorHelper<A>::GetElementAtIndex(a,index<I>()+i);
+			return  Access::element(a,coordinate<I>(i));
 		else
-			return get_partial<I+1>(WindowIteratorHelper<A>::GetElementAtIndex(a,index<I>()+i), rest...);
+			return get_partial<I+1>(Access::element(a,coordinate<I>(i)), rest...);
 	}
 	template<int I, class A>
-	constexpr int max(A& a)
+	void measure(A&& a)
 	{
-		static_assert(I < Dim);
-		static_assert( I >= 0 );
-		if constexpr ( I == 0 )
-			return WindowIteratorHelper<A>::GetMaxSize(a);
-		else
-			return max<I-1>(WindowIteratorHelper<A>::GetElementAtIndex(a,0));
+		extents[I] = WindowIteratorHelper<std::decay_t<A>>::GetMaxSize(a);
+		if constexpr ( I+1 < Dim )
+		{
+			if( extents[I] > 0 )
+				measure<I+1>(WindowIteratorHelper<std::decay_t<A>>::GetElementAtIndex(a,0));
+		}
+	}
+	void measure()
+	{
+		measure<0>(data);
+		for(int d = 0; d < Dim; ++d)
+		{
+			const int span = (win_size[d]-1)*dilation(d) + 1;
+			if( !padded )
+				positions[d] = extents[d] >= span ? (extents[d] - span)/stride(d) + 1 : 0;
+			else
+			{
+				positions[d] = (extents[d] + stride(d) - 1)/stride(d);
+				before[d] = std::max((positions[d]-1)*stride(d) + span - extents[d], 0)/2;
+			}
+		}
+		//no positions at all if some dimension has none
+		for(int d = 1; d < Dim; ++d)
+			if( positions[d] <= 0 )
+				positions[0] = 0;
 	}
 	template<int I>
 	inline void increment_helper()
@@ -105,7 +284,7 @@ class WindowIterator {
 		static_assert(I < Dim);
 		const int ind = Dim-I-1;
 		++index<ind>();
-		if( index<ind>() + win_size.at(ind) > max<ind>(data) )
+		if( index<ind>() >= positions[ind] )
 		{
 			if constexpr ( I+1 < Dim )
 			{
@@ -114,35 +293,93 @@ class WindowIterator {
 			}
 		}
 	}
-	template<class Other>
-	WindowIterator(Other& data, WindowIterator<Other,Dim> other) : 
-			data(data), ind{other.ind}, win_size(other.win_size) {}
+	static std::array<int,Dim> ones()
+	{
+		std::array<int,Dim> ret;
+		ret.fill(1);
+		return ret;
+	}
+	template<class Other, class OtherAccess>
+	WindowIterator(T& data, const WindowIterator<Other,Dim,OtherAccess,Mode>& other) :
+			data(data), ind{other.ind}, win_size(other.win_size), strides(other.strides), dilations(other.dilations) {
+		measure();
+	}
 public:
+	//runtime strides and dilations are 1
 	template<typename...Dims>
-	WindowIterator(T& data, Dims...d) : data(data), ind{0}, win_size({d...}) {
+	WindowIterator(T& data, Dims...d) : data(data), ind{0}, win_size({d...}), strides(ones()), dilations(ones()) {
 		static_assert(sizeof...(d) == Dim);
+		measure();
 	}
-	bool done() {return index<0>() + win_size.at(0) > max<0>(data);}
+	//for WindowRuntime modes
+	WindowIterator(T& data, const std::array<int,Dim>& win_size, const std::array<int,Dim>& strides,
+			const std::array<int,Dim>& dilations = ones()) :
+			data(data), ind{0}, win_size(win_size), strides(strides), dilations(dilations) {
+		static_assert(Mode::Stride == 0 and Mode::Dilation == 0, "strides and dilations of this mode are constants");
+		for(int d = 0; d < Dim; ++d)
+			assert( strides[d] > 0 and dilations[d] > 0 );
+		measure();
+	}
+	bool done() const {return ind[0] >= positions[0];}
 	inline WindowIterator& operator++(){
 		increment_helper<0>();
 		return *this;
 	}
+	//the window position, counted in strides: the index of the window's result in the output
 	template<int I>
 	constexpr int& index()
 	{
 		static_assert(I < Dim);
 		return ind[I];
 	}
+	//where the window starts in the data (negative or past the end in the padding)
+	template<int I>
+	int origin() const
+	{
+		static_assert(I < Dim);
+		return ind[I]*stride(I) - before[I];
+	}
+	//with Same padding, elements can only be read (the padding is a shared T()), and only whole indexes
 	template<typename...Rest>
 	inline auto& get(int i, Rest...rest)
 	{
 		static_assert(sizeof...(rest)+1 <= Dim);
-		return get_partial<0>(data, i, rest...);
+		if constexpr ( Mode::Padding == WindowPadding::Same )
+		{
+			static_assert(sizeof...(rest)+1 == Dim, "Same padding only gives elements");
+			typedef std::decay_t<decltype(get_partial<0>(data, i, rest...))> Element;
+			static const Element padding{};
+			if( !inside<0>(i, rest...) )
+				return padding;
+			return static_cast<const Element&>(get_partial<0>(data, i, rest...));
+		}
+		else
+			return get_partial<0>(data, i, rest...);
 	}
 	template<class Other>
-	WindowIterator<Other,Dim> on(Other& other_array)
+	WindowIterator<Other,Dim,Access,Mode> on(Other& other_array)
 	{
-		return WindowIterator<Other,Dim>(other_array, *this);
+		return WindowIterator<Other,Dim,Access,Mode>(other_array, *this);
+	}
+	//the same window positions, with the elements reached through another access policy
+	template<class OtherAccess>
+	WindowIterator<T,Dim,OtherAccess,Mode> with()
+	{
+		return WindowIterator<T,Dim,OtherAccess,Mode>(data, *this);
+	}
+	//the current window as a multi_flat_view_t, for data that has views (MultiArray.h): the window
+	//is checked against the data once here, and the view's operator() does no further checks
+	auto window()
+	{
+		static_assert(!padded and Mode::Dilation <= 1, "windows of padded or dilated modes are not views");
+		std::array<int,Dim> start, end;
+		for(int d = 0; d < Dim; ++d)
+		{
+			assert( dilation(d) == 1 );
+			start[d] = ind[d]*stride(d);
+			end[d] = start[d] + win_size[d];
+		}
+		return WindowIteratorHelper<T>::GetView(data).sub(start, end);
 	}
 	template<int I>
 	constexpr int getWinSize()
@@ -150,116 +387,107 @@ public:
 		static_assert(I < Dim);
 		return win_size[I];
 	}
+	//every window position, regardless of the current one
+	WindowRange<Dim> range() const {return WindowRange<Dim>(positions);}
+	void setPosition(const std::array<int,Dim>& position) {ind = position;}
 	template<typename...Rest>
 	inline void setIndexes(int i, Rest...rest)
 	{
+		static_assert(sizeof...(rest)+1 == Dim);
+		ind = {i, rest...};
 	}
 };
 
+//calls func(window) for the window positions of range, window being a copy of it moved to each of them
+template<class T, int Dim, class Access, class Mode, class Func>
+void for_each_window(const WindowIterator<T,Dim,Access,Mode>& it, const WindowRange<Dim>& range, Func&& func)
+{
+	if( range.empty() )
+		return;
+	WindowIterator<T,Dim,Access,Mode> window(it);
+	window.setPosition(range.position(range.getBegin()));
+	for(std::size_t n = range.size(); n > 0; --n, ++window)
+		func(window);
+}
+
+/*
+   Runs over every window position of it's data on a thread pool (from any starting position of it):
+
+	ThreadPool pool;
+	parallel_for_each_window(pool, WindowIterator(image, 3, 3), [&](auto& w) {
+		out(w.template index<0>(), w.template index<1>()) = w.get(0,0) + w.get(1,1) + w.get(2,2);
+	});
+
+   The positions are split into disjoint blocks of grain consecutive positions (by default enough
+     blocks to balance the threads), each walked by its own copy of it; func must be safe to call
+	 concurrently for different positions.
+*/
+template<class T, int Dim, class Access, class Mode, class Func>
+void parallel_for_each_window(ThreadPool& pool, const WindowIterator<T,Dim,Access,Mode>& it, Func&& func, std::size_t grain = 0)
+{
+	const WindowRange<Dim> all = it.range();
+	if( grain == 0 )
+		grain = std::max<std::size_t>(1, all.size() / (pool.size()*16));
+	const std::size_t blocks = (all.size() + grain - 1) / grain;
+	pool.parallelFor(0, blocks, 1, [&](std::size_t b) {
+		for_each_window(it, all.block(b, blocks), func);
+	});
+}
+
 template<class T, typename...Dims>
 WindowIterator(T, Dims...) -> WindowIterator<T, sizeof...(Dims)>;
 
 /* =============================
-   multi_array_t / multi_vector_t
+   multi_array_t / multi_vector_t / multi_flat_array_t (MultiArray.h)
    ============================= */
 
-namespace details {
+template<class T, std::size_t Dim>
+struct WindowIteratorHelper<multi_vector_t<T,Dim>> : public WindowIteratorHelper<typename multi_vector_t<T,Dim>::type> {};
 
 template<class T, int I, int...Rest>
-struct multi_array_impl {
-	using type = std::array<typename multi_array_impl<T,Rest...>::type, I>;
-};
-template<class T, int I>
-struct multi_array_impl<T,I> {
-	using type = std::array<T, I>;
-};
-
-template<class T, int Dim>
-struct multi_vector_impl {
-	static_assert( Dim > 1 );
-	using type = std::vector<typename multi_vector_impl<T,Dim-1>::type>;
-};
-template<class T>
-struct multi_vector_impl<T,1> {
-	using type = std::vector<T>;
-};
-
-} /* namespace details */
+struct WindowIteratorHelper<multi_array_t<T,I,Rest...>> : public WindowIteratorHelper<typename multi_array_t<T,I,Rest...>::type> {};
 
-template<class T,int I, int...Rest>
-class multi_array_t : public details::multi_array_impl<T, I, Rest...>::type {
-	template<class A>
-	inline constexpr auto& atHelper(A& a, int FirstIndex)
-	{
-		return a.at(FirstIndex);
-	}
-	template<class A, class...RestIndexTy>
-	inline constexpr auto& atHelper(A& a, int FirstIndex, RestIndexTy...RestIndex)
+//the outer dimensions give views of the ones below them
+template<class T, std::size_t Dim>
+struct WindowIteratorHelper<multi_flat_view_t<T,Dim>> {
+	static decltype(auto) GetElementAtIndex(const multi_flat_view_t<T,Dim>& t, int i)
 	{
-		return atHelper(a.at(FirstIndex), RestIndex...);
-	}
-public:
-	typedef typename details::multi_array_impl<T, I, Rest...>::type type;
-	using type::type;
-	template<class...RestIndexTy>
-	inline constexpr auto& at(int FirstIndex, RestIndexTy...RestIndex)
-	{
-		return atHelper(*static_cast<type*>(this),FirstIndex,RestIndex...);
+		if constexpr (Dim == 1)
+			return t.at(i);
+		else
+			return t.slice(i);
 	}
-	void fill(T value)
+	static decltype(auto) GetElementAtIndexUnchecked(const multi_flat_view_t<T,Dim>& t, int i)
 	{
-		if constexpr (sizeof...(Rest))
-		{
-			multi_array_t<T,Rest...> partial;
-			partial.fill(value);
-			type::fill(partial);
-		}
+		if constexpr (Dim == 1)
+			return t(i);
 		else
-			type::fill(value);
+			return t.sliceUnchecked(i);
 	}
+	static int GetMaxSize(const multi_flat_view_t<T,Dim>& t){return t.size(0);}
+	static multi_flat_view_t<T,Dim> GetView(const multi_flat_view_t<T,Dim>& t){return t;}
 };
 
-template<class T,int Dim>
-class multi_vector_t : public details::multi_vector_impl<T, Dim>::type {
-	template<class A>
-	inline constexpr auto& atHelper(A& a, int FirstIndex)
+template<class T, std::size_t Dim, std::size_t Alignment>
+struct WindowIteratorHelper<multi_flat_array_t<T,Dim,Alignment>> {
+	static decltype(auto) GetElementAtIndex(multi_flat_array_t<T,Dim,Alignment>& t, int i)
 	{
-		return a.at(FirstIndex);
-	}
-	template<class A, class...RestIndexTy>
-	inline constexpr auto& atHelper(A& a, int FirstIndex, RestIndexTy...RestIndex)
-	{
-		return atHelper(a.at(FirstIndex), RestIndex...);
-	}
-	template<class A, class...RestSizeTy>
-	void resizeHelper(A& a, int firstSize, RestSizeTy...restSize)
-	{
-		a.resize(firstSize);
-		if constexpr (sizeof...(restSize))
-			for(auto& V : a)
-				resizeHelper(V, restSize...);
-	}
-public:
-	typedef typename details::multi_vector_impl<T, Dim>::type type;
-	using type::type;
-	template<class...RestIndexTy>
-	inline constexpr auto& at(int FirstIndex, RestIndexTy...RestIndex)
-	{
-		return atHelper(*static_cast<type*>(this),FirstIndex,RestIndex...);
+		if constexpr (Dim == 1)
+			return t.at(i);
+		else
+			return t.slice(i);
 	}
-	template<class...RestSizeTy>
-	typename std::enable_if<(Dim > 1)>::type resize(int firstSize, RestSizeTy...restSize)
+	static decltype(auto) GetElementAtIndexUnchecked(multi_flat_array_t<T,Dim,Alignment>& t, int i)
 	{
-		resizeHelper(*static_cast<type*>(this), firstSize, restSize...);
+		if constexpr (Dim == 1)
+			return t(i);
+		else
+			return t.view().sliceUnchecked(i);
 	}
+	static int GetMaxSize(multi_flat_array_t<T,Dim,Alignment>& t){return t.size(0);}
+	static multi_flat_view_t<T,Dim> GetView(multi_flat_array_t<T,Dim,Alignment>& t){return t.view();}
 };
 
-template<class T, int Dim>
-struct WindowIteratorHelper<multi_vector_t<T,Dim>> : public WindowIteratorHelper<typename multi_vector_t<T,Dim>::type> {};
-
-template<class T, int I, int...Rest>
-struct WindowIteratorHelper<multi_array_t<T,I,Rest...>> : public WindowIteratorHelper<typename multi_array_t<T,I,Rest...>::type> {};
-
 
 #endif /* WINDOW_ITERATOR_H__ */
 
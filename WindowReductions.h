@@ -0,0 +1,242 @@
+#ifndef WINDOW_REDUCTIONS_H__
+#define WINDOW_REDUCTIONS_H__
+
+#include "WindowIterator.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+   Reductions over every window position at once, for 1D and 2D data that WindowIterator can walk
+     (std::vector, std::array, std::string, multi_array_t, multi_vector_t, multi_flat_array_t, ...):
+
+	std::vector<int> signal = ...;
+	std::vector<std::int64_t> sums = windowSums(signal, 16);        //sums[i]: signal[i] .. signal[i+15]
+	multi_flat_array_t<float,2> image = ...;
+	multi_flat_array_t<float,2> lows = windowMins(image, 5, 5);      //lows(r,c): the minimum of the 5x5 window at (r,c)
+	auto bright = windowCounts(image, [](float v) {return v > 0.9f;}, 5, 5);
+
+   The results have one element per window position, in the positions WindowIterator visits:
+     size - window + 1 per dimension (nothing if the window does not fit).
+   Each position costs O(1) regardless of the window size: sums, means and counts subtract entries of
+     prefix sums (a summed-area table in 2D), whose inner loops are contiguous and vectorize; minimums and
+	 maximums keep a monotonic deque of candidates, in 2D along the rows and then along the columns.
+   Sums of integer types are std::int64_t, and of floating point types double.
+   2D data must be rectangular: nested containers whose rows differ in length throw std::invalid_argument.
+*/
+
+template<class T>
+using WindowSumType = typename std::conditional<std::is_floating_point<T>::value, double, std::int64_t>::type;
+
+namespace details {
+
+//elements are reached unchecked: the loops below stay within the sizes the helpers report, and
+//windowColumns() checks that every row has as many columns as the first
+template<class Data>
+decltype(auto) windowElement(Data& data, int i)
+{
+	return WindowIteratorHelper<Data>::GetElementAtIndexUnchecked(data, i);
+}
+template<class Data>
+decltype(auto) windowElement(Data& data, int r, int c)
+{
+	auto&& row = windowElement(data, r);
+	return WindowIteratorHelper<std::decay_t<decltype(row)>>::GetElementAtIndexUnchecked(row, c);
+}
+template<class Data>
+int windowColumns(Data& data)
+{
+	const int rows = WindowIteratorHelper<Data>::GetMaxSize(data);
+	if( rows == 0 )
+		return 0;
+	auto&& first = windowElement(data, 0);
+	const int columns = WindowIteratorHelper<std::decay_t<decltype(first)>>::GetMaxSize(first);
+	for(int r = 1; r < rows; ++r)
+	{
+		auto&& row = windowElement(data, r);
+		if( WindowIteratorHelper<std::decay_t<decltype(row)>>::GetMaxSize(row) != columns )
+			throw std::invalid_argument("Window reductions need rows of equal length!");
+	}
+	return columns;
+}
+inline int windowPositions(int size, int window)
+{
+	return window > 0 and window <= size ? size - window + 1 : 0;
+}
+
+template<class Sum, class Data, class Transform>
+std::vector<Sum> slidingSums(Data& data, int width, Transform transform)
+{
+	const int n = WindowIteratorHelper<Data>::GetMaxSize(data);
+	std::vector<Sum> ret(windowPositions(n, width));
+	if( ret.empty() )
+		return ret;
+	std::vector<Sum> prefix(n+1);
+	prefix[0] = Sum();
+	for(int i = 0; i < n; ++i)
+		prefix[i+1] = prefix[i] + Sum(transform(windowElement(data, i)));
+	const Sum* high = prefix.data() + width;
+	const Sum* low = prefix.data();
+	Sum* out = ret.data();
+	for(std::size_t i = 0; i < ret.size(); ++i)
+		out[i] = high[i] - low[i];
+	return ret;
+}
+template<class Sum, class Data, class Transform>
+multi_flat_array_t<Sum,2> slidingSums(Data& data, int height, int width, Transform transform)
+{
+	const int rows = WindowIteratorHelper<Data>::GetMaxSize(data), columns = windowColumns(data);
+	const int outRows = windowPositions(rows, height), outColumns = windowPositions(columns, width);
+	if( outRows == 0 or outColumns == 0 )
+		return multi_flat_array_t<Sum,2>(0, 0);
+	multi_flat_array_t<Sum,2> ret(outRows, outColumns);
+	//table(r,c): the sum of the elements above and left of (r,c)
+	multi_flat_array_t<Sum,2> table(rows+1, columns+1);
+	for(int r = 0; r < rows; ++r)
+	{
+		Sum rowSum = Sum();
+		const Sum* above = &table(r, 0);
+		Sum* current = &table(r+1, 0);
+		for(int c = 0; c < columns; ++c)
+		{
+			rowSum += Sum(transform(windowElement(data, r, c)));
+			current[c+1] = above[c+1] + rowSum;
+		}
+	}
+	for(int r = 0; r < outRows; ++r)
+	{
+		const Sum* top = &table(r, 0);
+		const Sum* bottom = &table(r+height, 0);
+		Sum* out = &ret(r, 0);
+		for(int c = 0; c < outColumns; ++c)
+			out[c] = bottom[c+width] - top[c+width] - bottom[c] + top[c];
+	}
+	return ret;
+}
+
+//calls out(i, best) for every window of width in [0,n), where best is the element of the window that
+//is better than all the others (or equal)
+template<class Get, class Better, class Out>
+void slidingExtremes(int n, int width, Get get, Better better, Out out, std::vector<int>& deque)
+{
+	deque.resize(n);
+	int head = 0, tail = 0;
+	for(int i = 0; i < n; ++i)
+	{
+		const auto value = get(i);
+		while( tail > head and !better(get(deque[tail-1]), value) )
+			--tail;
+		deque[tail++] = i;
+		if( deque[head] <= i - width )
+			++head;
+		if( i >= width-1 )
+			out(i-width+1, get(deque[head]));
+	}
+}
+template<class Data, class Better>
+auto slidingExtremes(Data& data, int width, Better better)
+{
+	typedef std::decay_t<decltype(windowElement(data, 0))> Element;
+	const int n = WindowIteratorHelper<Data>::GetMaxSize(data);
+	std::vector<Element> ret(windowPositions(n, width));
+	if( ret.empty() )
+		return ret;
+	std::vector<int> deque;
+	slidingExtremes(n, width, [&](int i) -> Element {return windowElement(data, i);}, better,
+			[&](int i, const Element& value) {ret[i] = value;}, deque);
+	return ret;
+}
+template<class Data, class Better>
+auto slidingExtremes(Data& data, int height, int width, Better better)
+{
+	typedef std::decay_t<decltype(windowElement(data, 0, 0))> Element;
+	const int rows = WindowIteratorHelper<Data>::GetMaxSize(data), columns = windowColumns(data);
+	const int outRows = windowPositions(rows, height), outColumns = windowPositions(columns, width);
+	if( outRows == 0 or outColumns == 0 )
+		return multi_flat_array_t<Element,2>(0, 0);
+	//along the rows first, then along the columns of that
+	multi_flat_array_t<Element,2> across(rows, outColumns), ret(outRows, outColumns);
+	std::vector<int> deque;
+	for(int r = 0; r < rows; ++r)
+		slidingExtremes(columns, width, [&](int c) -> Element {return windowElement(data, r, c);}, better,
+				[&](int c, const Element& value) {across(r, c) = value;}, deque);
+	for(int c = 0; c < outColumns; ++c)
+		slidingExtremes(rows, height, [&](int r) -> Element {return across(r, c);}, better,
+				[&](int r, const Element& value) {ret(r, c) = value;}, deque);
+	return ret;
+}
+
+struct WindowIdentity {
+	template<class T>
+	const T& operator () (const T& t) const {return t;}
+};
+
+} /* namespace details */
+
+template<class Data>
+auto windowSums(Data& data, int width)
+{
+	typedef std::decay_t<decltype(details::windowElement(data, 0))> Element;
+	return details::slidingSums<WindowSumType<Element>>(data, width, details::WindowIdentity());
+}
+template<class Data>
+auto windowSums(Data& data, int height, int width)
+{
+	typedef std::decay_t<decltype(details::windowElement(data, 0, 0))> Element;
+	return details::slidingSums<WindowSumType<Element>>(data, height, width, details::WindowIdentity());
+}
+
+template<class Data>
+std::vector<double> windowMeans(Data& data, int width)
+{
+	std::vector<double> ret = details::slidingSums<double>(data, width, details::WindowIdentity());
+	for(auto& R : ret)
+		R /= width;
+	return ret;
+}
+template<class Data>
+multi_flat_array_t<double,2> windowMeans(Data& data, int height, int width)
+{
+	multi_flat_array_t<double,2> ret = details::slidingSums<double>(data, height, width, details::WindowIdentity());
+	const double area = double(height) * width;
+	for(int r = 0; r < ret.size(0); ++r)
+		for(int c = 0; c < ret.size(1); ++c)
+			ret(r, c) /= area;
+	return ret;
+}
+
+//the number of elements of every window for which pred(element) is true
+template<class Data, class Pred>
+std::vector<std::int64_t> windowCounts(Data& data, Pred pred, int width)
+{
+	return details::slidingSums<std::int64_t>(data, width, [&](const auto& e) {return pred(e) ? 1 : 0;});
+}
+template<class Data, class Pred>
+multi_flat_array_t<std::int64_t,2> windowCounts(Data& data, Pred pred, int height, int width)
+{
+	return details::slidingSums<std::int64_t>(data, height, width, [&](const auto& e) {return pred(e) ? 1 : 0;});
+}
+
+template<class Data>
+auto windowMins(Data& data, int width)
+{
+	return details::slidingExtremes(data, width, [](const auto& lhs, const auto& rhs) {return lhs < rhs;});
+}
+template<class Data>
+auto windowMins(Data& data, int height, int width)
+{
+	return details::slidingExtremes(data, height, width, [](const auto& lhs, const auto& rhs) {return lhs < rhs;});
+}
+template<class Data>
+auto windowMaxs(Data& data, int width)
+{
+	return details::slidingExtremes(data, width, [](const auto& lhs, const auto& rhs) {return rhs < lhs;});
+}
+template<class Data>
+auto windowMaxs(Data& data, int height, int width)
+{
+	return details::slidingExtremes(data, height, width, [](const auto& lhs, const auto& rhs) {return rhs < lhs;});
+}
+
+#endif /* WINDOW_REDUCTIONS_H__ */